@@ -14,6 +14,15 @@
 #include "os-mm.h"
 #endif
 
+/* Policies left unset in os-cfg.h */
+#ifndef MM_REPL_POLICY
+#define MM_REPL_POLICY PAGING_REPL_FIFO
+#endif
+
+#ifndef MM_SWAP_POLICY
+#define MM_SWAP_POLICY PAGING_SWAP_PRIO
+#endif
+
 #define ADDRESS_SIZE 20
 #define OFFSET_LEN 10
 #define FIRST_LV_LEN 5
@@ -129,6 +138,7 @@ struct krnl_t
 	struct memphy_struct **mswp;
 	struct memphy_struct *active_mswp;
 	uint32_t active_mswp_id;
+	struct swap_struct *swap;
 #endif
 };
 
@@ -4,28 +4,71 @@
 #include "bitops.h"
 
 /* CPU Bus definition */
+#ifdef MM64
+#define PAGING_CPU_BUS_WIDTH 57 /* 57bit bus of the 5-level table */
+#else
 #define PAGING_CPU_BUS_WIDTH 22 /* 22bit bus - MAX SPACE 4MB */
+#endif
 #define PAGING_PAGESZ  256      /* 256B or 8-bits PAGE NUMBER */
 #define PAGING_MEMRAMSZ BIT(21)
 #define PAGING_PAGE_ALIGNSZ(sz) (DIV_ROUND_UP(sz,PAGING_PAGESZ)*PAGING_PAGESZ)
 
 #define PAGING_MEMSWPSZ BIT(29)
 #define PAGING_SWPFPN_OFFSET 5  
-#define PAGING_MAX_PGN  (DIV_ROUND_UP(BIT(PAGING_CPU_BUS_WIDTH),PAGING_PAGESZ))
+#define PAGING_MAX_PGN  (DIV_ROUND_UP(BIT_ULL(PAGING_CPU_BUS_WIDTH),PAGING_PAGESZ))
+
+/* Shared memory segments are attached in the upper half of the page
+ * numbers, the radix walk resolves PAGING_CPU_BUS_WIDTH - 12 bits of them */
+#ifdef MM64
+#define PAGING_SHM_BASE (BIT_ULL(PAGING_CPU_BUS_WIDTH - 12 - 1) * PAGING_PAGESZ)
+#else
+#define PAGING_SHM_BASE BIT_ULL(PAGING_CPU_BUS_WIDTH - 1)
+#endif
 
 #define PAGING_SBRK_INIT_SZ PAGING_PAGESZ
 /* PTE BIT */
+#ifdef MM64
+/* 64-bit PTE: flags on top, FPN or swap type/offset in the low bits */
+#define PAGING_PTE_PRESENT_MASK BIT_ULL(63)
+#define PAGING_PTE_SWAPPED_MASK BIT_ULL(62)
+#define PAGING_PTE_RESERVE_MASK BIT_ULL(61)
+#define PAGING_PTE_DIRTY_MASK BIT_ULL(60)
+#define PAGING_PTE_EMPTY01_MASK BIT_ULL(47)
+#define PAGING_PTE_EMPTY02_MASK BIT_ULL(46)
+#define PAGING_PTE_GENMASK(h,l) GENMASK_ULL(h,l)
+#else
 #define PAGING_PTE_PRESENT_MASK BIT(31) 
 #define PAGING_PTE_SWAPPED_MASK BIT(30)
 #define PAGING_PTE_RESERVE_MASK BIT(29)
 #define PAGING_PTE_DIRTY_MASK BIT(28)
 #define PAGING_PTE_EMPTY01_MASK BIT(14)
 #define PAGING_PTE_EMPTY02_MASK BIT(13)
+#define PAGING_PTE_GENMASK(h,l) GENMASK(h,l)
+#endif
+
+/* Read-only mapping, a write goes through a private copy in pg_setval */
+#define PAGING_PTE_RDONLY_MASK PAGING_PTE_EMPTY01_MASK
+/* Set when the translation is loaded for an access, cleared by CLOCK */
+#define PAGING_PTE_ACCESSED_MASK PAGING_PTE_EMPTY02_MASK
 
 /* PTE BIT PRESENT */
 #define PAGING_PTE_SET_PRESENT(pte) (pte=pte|PAGING_PTE_PRESENT_MASK)
 #define PAGING_PAGE_PRESENT(pte) (pte&PAGING_PTE_PRESENT_MASK)
 
+#ifdef MM64
+/* USRNUM */
+#define PAGING_PTE_USRNUM_LOBIT 48
+#define PAGING_PTE_USRNUM_HIBIT 59
+/* FPN - 2^46 frames */
+#define PAGING_PTE_FPN_LOBIT 0
+#define PAGING_PTE_FPN_HIBIT 45
+/* SWPTYP */
+#define PAGING_PTE_SWPTYP_LOBIT 0
+#define PAGING_PTE_SWPTYP_HIBIT 4
+/* SWPOFF - 2^41 swap frames */
+#define PAGING_PTE_SWPOFF_LOBIT 5
+#define PAGING_PTE_SWPOFF_HIBIT 45
+#else
 /* USRNUM */
 #define PAGING_PTE_USRNUM_LOBIT 15
 #define PAGING_PTE_USRNUM_HIBIT 27
@@ -38,12 +81,13 @@
 /* SWPOFF */
 #define PAGING_PTE_SWPOFF_LOBIT 5
 #define PAGING_PTE_SWPOFF_HIBIT 25
+#endif
 
 /* PTE */
-#define PAGING_PTE_USRNUM_MASK GENMASK(PAGING_PTE_USRNUM_HIBIT,PAGING_PTE_USRNUM_LOBIT)
-#define PAGING_PTE_FPN_MASK    GENMASK(PAGING_PTE_FPN_HIBIT,PAGING_PTE_FPN_LOBIT)
-#define PAGING_PTE_SWPTYP_MASK GENMASK(PAGING_PTE_SWPTYP_HIBIT,PAGING_PTE_SWPTYP_LOBIT)
-#define PAGING_PTE_SWPOFF_MASK GENMASK(PAGING_PTE_SWPOFF_HIBIT,PAGING_PTE_SWPOFF_LOBIT)
+#define PAGING_PTE_USRNUM_MASK PAGING_PTE_GENMASK(PAGING_PTE_USRNUM_HIBIT,PAGING_PTE_USRNUM_LOBIT)
+#define PAGING_PTE_FPN_MASK    PAGING_PTE_GENMASK(PAGING_PTE_FPN_HIBIT,PAGING_PTE_FPN_LOBIT)
+#define PAGING_PTE_SWPTYP_MASK PAGING_PTE_GENMASK(PAGING_PTE_SWPTYP_HIBIT,PAGING_PTE_SWPTYP_LOBIT)
+#define PAGING_PTE_SWPOFF_MASK PAGING_PTE_GENMASK(PAGING_PTE_SWPOFF_HIBIT,PAGING_PTE_SWPOFF_LOBIT)
 
 /* Extract PTE */
 #define PAGING_PTE_OFFST(pte) GETVAL(pte,PAGING_OFFST_MASK,PAGING_ADDR_OFFST_LOBIT)
@@ -67,6 +111,7 @@
 #define PAGING_SWP_LOBIT NBITS(PAGING_PAGESZ)
 #define PAGING_SWP_HIBIT (NBITS(PAGING_MEMSWPSZ) - 1)
 #define PAGING_SWP(pte) ((pte&PAGING_PTE_SWPOFF_MASK) >> PAGING_SWPFPN_OFFSET)
+#define PAGING_SWPTYP(pte) ((pte&PAGING_PTE_SWPTYP_MASK) >> PAGING_PTE_SWPTYP_LOBIT)
 
 /* Value operators */
 #define SETBIT(v,mask) (v=v|mask)
@@ -77,7 +122,11 @@
 
 /* Masks */
 #define PAGING_OFFST_MASK  GENMASK(PAGING_ADDR_OFFST_HIBIT,PAGING_ADDR_OFFST_LOBIT)
+#ifdef MM64
+#define PAGING_PGN_MASK  GENMASK_ULL(PAGING_ADDR_PGN_HIBIT,PAGING_ADDR_PGN_LOBIT)
+#else
 #define PAGING_PGN_MASK  GENMASK(PAGING_ADDR_PGN_HIBIT,PAGING_ADDR_PGN_LOBIT)
+#endif
 #define PAGING_FPN_MASK  GENMASK(PAGING_ADDR_FPN_HIBIT,PAGING_ADDR_FPN_LOBIT)
 #define PAGING_SWP_MASK  GENMASK(PAGING_SWP_HIBIT,PAGING_SWP_LOBIT)
 
@@ -101,20 +150,39 @@
 /* VM region prototypes */
 struct vm_rg_struct * init_vm_rg(addr_t rg_start, addr_t rg_end);
 int enlist_vm_rg_node(struct vm_rg_struct **rglist, struct vm_rg_struct* rgnode);
-int enlist_pgn_node(struct pgn_t **pgnlist, addr_t pgn);
+int enlist_pgn_node(struct pcb_t *caller, addr_t pgn, addr_t fpn);
+int enlist_pgn_range(struct pcb_t *caller, addr_t pgn, int pgnum, struct framephy_struct *frames);
+int delist_pgn_node(struct pcb_t *caller, addr_t fpn);
+void pgn_list_add(struct pgn_t **plist, struct pgn_t *pnode);
+void pgn_list_del(struct pgn_t **plist, struct pgn_t *pnode);
+struct pgn_t *pgn_desc(struct memphy_struct *mram, addr_t fpn);
+
+/* Adaptive replacement prototypes */
+int arc_enlist(struct pcb_t *caller, struct pgn_t *pnode);
+int arc_delist(struct mm_struct *mm, struct pgn_t *pnode);
+int arc_victim(struct pcb_t *caller, addr_t *retpgn);
+void arc_release(struct pgn_arc *arc);
 int vmap_pgd_memset(struct pcb_t *caller, addr_t addr, int pgnum);
+int vmap_zero_range(struct pcb_t *caller, addr_t pgn, int pgnum, addr_t fpn);
 addr_t vmap_page_range(struct pcb_t *caller, addr_t addr, int pgnum, 
                     struct framephy_struct *frames, struct vm_rg_struct *ret_rg);
 addr_t vm_map_ram(struct pcb_t *caller, addr_t astart, addr_t aend, addr_t mapstart, int incpgnum, struct vm_rg_struct *ret_rg);
 addr_t alloc_pages_range(struct pcb_t *caller, int incpgnum, struct framephy_struct **frm_lst);
 int __swap_cp_page(struct memphy_struct *mpsrc, addr_t srcfpn,
                 struct memphy_struct *mpdst, addr_t dstfpn) ;
+int __swap_mv_page(struct memphy_struct *mpsrc, addr_t srcfpn,
+                struct memphy_struct *mpdst, addr_t dstfpn) ;
 int get_pd_from_address(addr_t addr, addr_t* pgd, addr_t* p4d, addr_t* pud, addr_t* pmd, addr_t* pt);
 int get_pd_from_pagenum(addr_t pgn, addr_t* pgd, addr_t* p4d, addr_t* pud, addr_t* pmd, addr_t* pt);
 int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn);
 int pte_set_swap(struct pcb_t *caller, addr_t pgn, int swptyp, addr_t swpoff);
-uint32_t pte_get_entry(struct pcb_t *caller, addr_t pgn);
-int pte_set_entry(struct pcb_t *caller, addr_t pgn, uint32_t pte_val);
+int pte_set_rdonly(struct pcb_t *caller, addr_t pgn);
+int pte_set_bits(struct pcb_t *caller, addr_t pgn, addr_t mask);
+int pte_clr_bits(struct pcb_t *caller, addr_t pgn, addr_t mask);
+addr_t pte_get_entry(struct pcb_t *caller, addr_t pgn);
+int pte_lookup(struct pcb_t *caller, addr_t pgn, addr_t *pte);
+int vmap_huge_page(struct pcb_t *caller, addr_t pgn);
+int pte_set_entry(struct pcb_t *caller, addr_t pgn, addr_t pte_val);
 int init_pte(addr_t *pte,
              int pre,    // present
              addr_t fpn,    // FPN
@@ -127,6 +195,14 @@ int __free(struct pcb_t *caller, int vmaid, int rgid);
 int __read(struct pcb_t *caller, int vmaid, int rgid, addr_t offset, BYTE *data);
 int __write(struct pcb_t *caller, int vmaid, int rgid, addr_t offset, BYTE value);
 int init_mm(struct mm_struct *mm, struct pcb_t *caller);
+int copy_mm(struct pcb_t *caller, struct pcb_t *child);
+struct mm_struct *mmlist_next(struct mm_struct *mm);
+void mm_unlink(struct mm_struct *mm);
+void free_mm(struct mm_struct *mm);
+int free_pcb_memph(struct pcb_t *caller);
+int __shmget(int key, addr_t size);
+int __shmat(struct pcb_t *caller, int key, int rgid);
+int __shmdt(struct pcb_t *caller, int rgid);
 
 /* VM prototypes */
 int pgalloc(struct pcb_t *proc, uint32_t size, uint32_t reg_index);
@@ -146,16 +222,51 @@ struct vm_rg_struct * get_symrg_byid(struct mm_struct* mm, int rgid);
 int validate_overlap_vm_area(struct pcb_t *caller, int vmaid, addr_t vmastart, addr_t vmaend);
 int get_free_vmrg_area(struct pcb_t *caller, int vmaid, int size, struct vm_rg_struct *newrg);
 int inc_vma_limit(struct pcb_t *caller, int vmaid, addr_t inc_sz);
-int find_victim_page(struct mm_struct* mm, addr_t *pgn);
+int find_victim_page(struct pcb_t *caller, addr_t *pgn);
+int pg_reclaim(struct krnl_t *krnl);
 struct vm_area_struct *get_vma_by_num(struct mm_struct *mm, int vmaid);
 
+/* Swap area prototypes */
+int swap_init(struct swap_struct *swp, struct memphy_struct **devs, int nr, int policy);
+int swap_alloc(struct swap_struct *swp, int *swptyp, addr_t *swpoff);
+int swap_alloc_n(struct swap_struct *swp, int n, int *swptyp, addr_t *swpoff);
+int swap_free(struct swap_struct *swp, int swptyp, addr_t swpoff);
+struct memphy_struct *swap_dev(struct swap_struct *swp, int swptyp);
+int zswap_init(struct zswap_pool *zp, addr_t maxsz);
+int zswap_store(struct zswap_pool *zp, const BYTE *page, addr_t *idx);
+int zswap_load(struct zswap_pool *zp, addr_t idx, BYTE *page);
+int zswap_free(struct zswap_pool *zp, addr_t idx);
+int zswap_get_stats(struct zswap_pool *zp, addr_t *size, addr_t *stored, addr_t *rejected);
+
+/* TLB prototypes */
+int tlb_lookup(struct mm_struct *mm, uint32_t pid, addr_t pgn, addr_t *pte);
+int tlb_fill(struct mm_struct *mm, uint32_t pid, addr_t pgn, addr_t pte);
+int tlb_fill_huge(struct mm_struct *mm, uint32_t pid, addr_t pgn, addr_t pte, int order);
+int tlb_invalidate(struct mm_struct *mm, addr_t pgn);
+int tlb_invalidate_range(struct mm_struct *mm, addr_t pgn, addr_t pgnum);
+int tlb_get_stats(int cpuid, uint64_t *hits, uint64_t *misses);
+
 /* MEM/PHY protypes */
 int MEMPHY_get_freefp(struct memphy_struct *mp, addr_t *fpn);
 int MEMPHY_put_freefp(struct memphy_struct *mp, addr_t fpn);
+int MEMPHY_get_freefp_n(struct memphy_struct *mp, int n, addr_t *fpns);
+addr_t MEMPHY_get_nrfree(struct memphy_struct *mp);
+int MEMPHY_alloc_contig(struct memphy_struct *mp, int order, addr_t *fpn);
+int MEMPHY_free_contig(struct memphy_struct *mp, addr_t fpn, int order);
+void MEMPHY_bind_cpu(int cpuid);
+int MEMPHY_get_cpu(void);
 int MEMPHY_read(struct memphy_struct * mp, addr_t addr, BYTE *value);
 int MEMPHY_write(struct memphy_struct * mp, addr_t addr, BYTE data);
+int MEMPHY_read_block(struct memphy_struct *mp, addr_t addr, BYTE *buf, addr_t size);
+int MEMPHY_write_block(struct memphy_struct *mp, addr_t addr, const BYTE *buf, addr_t size);
+int MEMPHY_xchg_frame(struct memphy_struct *mpa, addr_t fpna,
+                      struct memphy_struct *mpb, addr_t fpnb);
+uint64_t MEMPHY_get_seekcost(struct memphy_struct *mp);
 int MEMPHY_dump(struct memphy_struct * mp);
+int MEMPHY_buddy_format(struct memphy_struct *mp, int pagesz);
 int init_memphy(struct memphy_struct *mp, addr_t max_size, int randomflg);
+int init_memphy_buddy(struct memphy_struct *mp, addr_t max_size, int randomflg);
+int init_memphy_file(struct memphy_struct *mp, addr_t max_size, int randomflg, const char *path);
 
 /* print list */
 int print_list_fp(struct framephy_struct *fp);
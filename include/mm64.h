@@ -13,6 +13,21 @@
 #define PAGING64_MAX_PGN  (DIV_ROUND_UP(BIT_ULL(21),PAGING64_PAGESZ))
 #define PAGING64_PAGE_ALIGNSZ(sz) (DIV_ROUND_UP(sz,PAGING64_PAGESZ)*PAGING64_PAGESZ)
 
+/* Radix page table geometry */
+#define PAGING64_PT_LEVELS 5         /* PGD, P4D, PUD, PMD, PT */
+#define PAGING64_PT_IDX_BITS 9
+#define PAGING64_PTRS_PER_TBL BIT(PAGING64_PT_IDX_BITS)
+#define PAGING64_LV_PMD 3
+#define PAGING64_LV_PT 4
+
+/* Huge PMD entry, maps PAGING64_HUGE_PGNUM pages to a contiguous run of
+ * frames; table addresses never have the top bit set */
+#define PAGING64_PDE_HUGE_MASK BIT_ULL(63)
+#define PAGING64_PDE_HUGE(pde) ((pde) & PAGING64_PDE_HUGE_MASK)
+#define PAGING64_PDE_FPN(pde) ((pde) & ~PAGING64_PDE_HUGE_MASK)
+#define PAGING64_HUGE_ORDER PAGING64_PT_IDX_BITS
+#define PAGING64_HUGE_PGNUM BIT(PAGING64_HUGE_ORDER)
+
 
 /* OFFSET */
 #define PAGING64_ADDR_OFFST_HIBIT 11
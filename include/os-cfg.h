@@ -22,6 +22,95 @@
 #define IODUMP 1
 #define PAGETBL_DUMP 1
 
+/*
+ * Back swap devices with files mapped through mmap instead of host heap,
+ * the pattern takes the swap device index. The files are kept after exit.
+ * input/os_mm_swapfile pages through them, build it with MM_DEMAND_PAGING.
+ */
+//#define MMSWP_FILE "mswp%d.img"
+
+/*
+ * Make the swap devices sequential access, every access moves the device
+ * cursor and the distance travelled is printed at exit as its seek cost.
+ * input/os_mm_swapseq pages through them, build it with MM_DEMAND_PAGING.
+ */
+//#define MMSWP_SEQ 1
+
+/*
+ * Swap slot placement over the configured swap devices, PAGING_SWAP_PRIO
+ * fills them in config order (default), PAGING_SWAP_STRIPE spreads pages
+ * round-robin. input/os_mm_swapdevs spills from a 4 slot first device,
+ * input/os_mm_swapstripe alternates the same devices.
+ */
+//#define MM_SWAP_POLICY PAGING_SWAP_STRIPE
+
+/*
+ * Keep evicted pages compressed in a host memory pool in front of the
+ * swap devices, a page only goes to a device when the pool rejects it.
+ * input/os_mm_zswap evicts a zero-filled, a sparse and a dense page
+ * through it, the dense one is rejected.
+ */
+//#define MM_ZSWAP 1
+
+/*
+ * Indirect heap device frames through a frame to buffer table, swapping a
+ * page exchanges the buffers of its RAM frame and swap slot instead of
+ * copying it. input/os_mm_frameind reads 12 pages back twice through 7
+ * frames, each page is exchanged in and out of its reserved slot.
+ */
+//#define MM_FRAME_INDIRECT 1
+
+/*
+ * Manage MEMRAM frames with the buddy allocator, it hands out physically
+ * contiguous power-of-two runs and merges them again on free.
+ * input/os_mm_buddy maps and rolls back runs of it.
+ */
+//#define MMRAM_BUDDY 1
+
+/*
+ * Map aligned PMD-sized chunks of an allocation with one huge entry backed
+ * by a contiguous frame run from the buddy allocator, needs MMRAM_BUDDY.
+ * input/os_mm_hugepage maps one, on first touch too with MM_DEMAND_PAGING.
+ */
+//#define MM_HUGEPAGE 1
+
+/*
+ * Lazy allocation, inc_vma_limit only extends the vm area and a page
+ * gets its zeroed frame on first access. Pages are only swapped out in
+ * this mode, the input/os_mm_* inputs that page to swap need it.
+ * input/os_mm_lazy allocates 16 times its RAM and touches three pages.
+ */
+//#define MM_DEMAND_PAGING 1
+
+/*
+ * Victim selection of find_victim_page, one of PAGING_REPL_FIFO,
+ * PAGING_REPL_CLOCK, PAGING_REPL_ECLOCK or PAGING_REPL_ARC, FIFO by default.
+ * input/os_mm_fifo, os_mm_clock and os_mm_eclock print the victims of
+ * one pattern under FIFO, CLOCK and ECLOCK, input/os_mm_arc refaults
+ * pages from both ARC ghost lists.
+ */
+//#define MM_REPL_POLICY PAGING_REPL_ARC
+
+/*
+ * Swap-in also brings in the following swapped pages of the vm area,
+ * the window doubles while those pages get used and halves otherwise
+ */
+//#define MM_SWAP_READAHEAD 1
+
+/*
+ * A first-touch fault also maps the untouched pages of its aligned
+ * PAGING_FAULT_AROUND window to the zero frame. input/os_mm_readahead
+ * drives both, build it with MM_SWAP_READAHEAD and MM_FAULT_AROUND.
+ */
+//#define MM_FAULT_AROUND 1
+
+/*
+ * Reclaim daemon, a timer device that swaps pages out in the background
+ * whenever the RAM free frames drop below the low watermark.
+ * input/os_mm_kswapd writes 144 pages through 128 frames with it.
+ */
+//#define MM_KSWAPD 1
+
 extern int runtime_paging; 
 /* 
  * @bksysnet:
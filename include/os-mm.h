@@ -19,6 +19,51 @@
 #define PAGING_MAX_MMSWP 4 /* max number of supported swapped space */
 #define PAGING_MAX_SYMTBL_SZ 30
 
+/* Per-CPU free frame caches (magazines) of a MEMPHY device */
+#define PAGING_MAX_CPU 16    /* CPUs with their own magazine */
+#define PAGING_MAG_SZ 16     /* frames cached per CPU */
+#define PAGING_MAG_MINFP (PAGING_MAX_CPU * PAGING_MAG_SZ * 4) /* smaller devices skip magazines */
+
+/* Per-CPU software TLB, set-associative and tagged by PID */
+#define PAGING_TLB_SETS 16
+#define PAGING_TLB_WAYS 4
+#define PAGING_TLB_HUGE_WAYS 4   /* fully associative huge page entries */
+
+/* Page-walk cache entries per mm (PT, PMD and PUD tables) */
+#define PAGING_PWC_LEVELS 3
+
+/* Buddy allocator, free blocks of 2^0 .. 2^MAX_ORDER contiguous frames */
+#define PAGING_BUDDY_MAX_ORDER 10
+#define PAGING_BUDDY_NIL ((addr_t)-1)
+#define PAGING_FPN_NIL ((addr_t)-1)
+
+/* Page replacement policies, selected by MM_REPL_POLICY */
+#define PAGING_REPL_FIFO 0
+#define PAGING_REPL_CLOCK 1   /* second chance on the accessed bit */
+#define PAGING_REPL_ECLOCK 2  /* enhanced CLOCK on (accessed, dirty) */
+#define PAGING_REPL_ARC 3     /* CAR, clock-based ARC with ghost lists */
+#define PAGING_ARC_HASH_MAX (1U << 16) /* ghost hash buckets upper bound */
+
+/* Swap readahead window bounds and fault-around window, in pages */
+#define PAGING_RA_INIT 4
+#define PAGING_RA_MAX 32
+#define PAGING_FAULT_AROUND 16  /* power of two, at most a leaf table */
+
+/* Swap slot allocation over the swap devices, selected by MM_SWAP_POLICY */
+#define PAGING_SWAP_PRIO 0     /* fill the highest priority device first */
+#define PAGING_SWAP_STRIPE 1   /* round-robin over every device */
+#define PAGING_SWAP_CLUSTER 32 /* slots reserved at once, a multiple of 32 */
+#define PAGING_SWAP_BATCH 16   /* victims written out together by reclaim */
+
+/* Compressed swap pool, its swap type and its size as a fraction of RAM */
+#define PAGING_SWP_ZSWAP PAGING_MAX_MMSWP
+#define PAGING_ZSWAP_POOL_DIV 4
+#define PAGING_ZSWAP_ENTRY_COST 16 /* bytes charged per entry on top of its data */
+
+/* Background reclaim watermarks, fractions of the RAM frames */
+#define PAGING_WMARK_LOW_DIV 32
+#define PAGING_WMARK_HIGH_DIV 16
+
 /* 
  * @bksysnet: in long address mode of 64bit or original 32bit
  * the address type need to be redefined
@@ -47,9 +92,94 @@ typedef ADDR_TYPE addr_t;
 #define FORMATX_ADDR "%08x"
 #endif
 
+/* Replacement descriptor of a RAM frame, lists are circular and
+ * doubly linked, pg_next == NULL when the frame is not enlisted */
 struct pgn_t{
    addr_t pgn;
    struct pgn_t *pg_next; 
+   struct pgn_t *pg_prev;
+   int pg_freq;   /* adaptive replacement: on the frequency list T2 */
+
+   /* Swap cache, the page still has a valid copy in swap slot pg_swpoff
+    * since it was swapped in; a clean eviction skips the write-back */
+   int pg_swcache;
+   int pg_swptyp;
+   addr_t pg_swpoff;
+
+   int pg_ra;     /* brought in by readahead, not accessed yet */
+
+   /* mm whose replacement lists hold the descriptor */
+   struct mm_struct *pg_mm;
+
+   /* Copy-on-write sharing after fork, the number of mms mapping the
+    * frame read-only at page pgn, 0 for a private frame. A shared frame
+    * is tracked on the lists of one of its mappers */
+   int pg_mapcount;
+};
+
+/* Ghost entry of an evicted page, remembered by the adaptive policy */
+struct pgn_ghost {
+   addr_t pgn;
+   struct pgn_ghost *gh_next;   /* circular LRU list, head is the newest */
+   struct pgn_ghost *gh_prev;
+   struct pgn_ghost *gh_hnext;  /* hash chain */
+   int gh_list;                 /* 1 for B1, 2 for B2 */
+};
+
+/* Clock with adaptive replacement (CAR) state of an mm, the recency
+ * clock T1 is mm->fifo_pgn */
+struct pgn_arc {
+   struct pgn_t *t2;            /* frequency clock */
+   struct pgn_ghost *b1;        /* ghosts evicted from T1 */
+   struct pgn_ghost *b2;        /* ghosts evicted from T2 */
+   addr_t nt1, nt2, nb1, nb2;
+   addr_t p;                    /* adaptive target size of T1 */
+
+   struct pgn_ghost **hash;     /* ghost lookup by page number */
+   addr_t hashsz;
+   struct pgn_ghost *pool;      /* recycled ghost entries */
+};
+
+/* Swap area of a swap device, one bitmap bit per page-sized slot */
+struct swap_info_struct {
+   struct memphy_struct *dev;
+   int prio;                    /* higher fills first */
+   addr_t nslots;
+   addr_t nfree;
+   uint32_t *map;               /* a set bit is a used slot */
+   addr_t hint;                 /* where the next slot search starts */
+   addr_t clu_next, clu_end;    /* free rest of the reserved cluster */
+};
+
+/* Compressed page of the swap pool, data == NULL for a page of fill */
+struct zswap_entry {
+   BYTE *data;
+   addr_t len;
+   BYTE fill;
+   int used;
+   addr_t next;                 /* free entry chain */
+};
+
+struct zswap_pool {
+   struct zswap_entry *tbl;
+   addr_t nr;
+   addr_t free;                 /* first free entry, PAGING_FPN_NIL if none */
+   addr_t maxsz;                /* compressed bytes the pool may hold */
+   addr_t size;
+   addr_t stored;               /* pages taken in since init */
+   addr_t rejected;             /* pages turned away to the swap devices */
+   pthread_mutex_t lock;
+};
+
+/* Swap areas indexed by swap type */
+struct swap_struct {
+   int nr;
+   int policy;
+   int next;                    /* round-robin cursor */
+   struct swap_info_struct info[PAGING_MAX_MMSWP];
+   pthread_mutex_t lock;
+
+   struct zswap_pool zpool;     /* swap type PAGING_SWP_ZSWAP */
 };
 
 /*
@@ -62,6 +192,25 @@ struct vm_rg_struct {
    struct vm_rg_struct *rg_next;
 };
 
+/*
+ *  Shared memory segment, created by shmget and mapped by shmat. Its
+ *  attachments are the reverse map of its pages, page i of the segment
+ *  is page pgn + i of every attached mm.
+ */
+struct shm_attach {
+   struct mm_struct *mm;
+   addr_t pgn;                  /* first page of the mapping */
+   struct shm_attach *next;
+};
+
+struct shm_segment {
+   int key;
+   addr_t npages;
+   int nattch;                  /* the segment goes with its last attachment */
+   struct shm_attach *attach;
+   struct shm_segment *next;
+};
+
 /*
  *  Memory area struct
  */
@@ -76,6 +225,7 @@ struct vm_area_struct {
  * unsigned long vm_limit = vm_end - vm_start
  */
    struct mm_struct *vm_mm;
+   struct shm_segment *vm_shm;  /* segment mapped by the area, NULL if anonymous */
    struct vm_rg_struct *vm_freerg_list;
    struct vm_area_struct *vm_next;
 };
@@ -89,11 +239,20 @@ struct mm_struct {
   *       compiler noisy only, this design need to be revised
   */
 #ifdef MM64
+   /* Root of the 5-level radix table, each directory entry holds the
+    * address of its lower-level table (P4D, PUD, PMD then PT) or 0 */
    addr_t *pgd;
-   addr_t *p4d;
-   addr_t *pud;
-   addr_t *pmd;
-   addr_t *pt;
+
+   /* Paging-structure cache, the last PT, PMD and PUD tables resolved
+    * by a walk tagged with the page number bits above each table */
+   struct {
+      addr_t tag;
+      addr_t *tbl;
+   } pwc[PAGING_PWC_LEVELS];
+
+   /* Walks that started from a cached table, and those from the PGD */
+   uint64_t pwc_hits;
+   uint64_t pwc_misses;
 #else
    uint32_t *pgd;
 #endif
@@ -103,8 +262,21 @@ struct mm_struct {
    /* Currently we support a fixed number of symbol */
    struct vm_rg_struct symrgtbl[PAGING_MAX_SYMTBL_SZ];
 
-   /* list of free page */
+   /* list of resident pages, head is the newest, head->pg_prev the oldest */
    struct pgn_t *fifo_pgn;
+
+   /* PAGING_REPL_ARC lists */
+   struct pgn_arc arc;
+
+   /* Swap readahead window, and its use since the last demand swap-in */
+   struct {
+      addr_t win;
+      addr_t hits;
+      addr_t issued;
+   } ra;
+
+   /* Next on the list of every mm */
+   struct mm_struct *mmlist;
 };
 
 /*
@@ -118,18 +290,54 @@ struct framephy_struct {
    struct mm_struct* owner;
 };
 
+/*
+ * Per-CPU magazine, the lock is uncontended except when an allocation
+ * that found the device empty drains every magazine
+ */
+struct memphy_mag {
+   pthread_mutex_t lock;
+   int nr;
+   addr_t fpn[PAGING_MAG_SZ];
+};
+
 struct memphy_struct {
    /* Basic field of data and size */
    BYTE *storage;
-   int maxsz;
+   addr_t maxsz;
+
+   /* Backing file of a memory-mapped device, -1 for host heap */
+   int fd;
    
    /* Sequential device fields */ 
    int rdmflg; 
-   int cursor;
+   addr_t cursor;
+   uint64_t seekcost; /* Total distance the cursor travelled */
 
    /* Management structure */
    struct framephy_struct *free_fp_list;
    struct framephy_struct *used_fp_list;
+   addr_t nr_free;    /* free frames, those parked in magazines excluded */
+
+   /* Per-CPU free frame caches, NULL when disabled */
+   struct memphy_mag *mags;
+
+   /* Buddy allocator mode, replaces free_fp_list when bd_order != NULL
+    * bd_order[fpn] is the order of the free block starting at fpn or -1,
+    * free blocks of one order are doubly linked through bd_next/bd_prev */
+   signed char *bd_order;
+   addr_t *bd_next;
+   addr_t *bd_prev;
+   addr_t bd_head[PAGING_BUDDY_MAX_ORDER + 1];
+   addr_t bd_numfp;
+
+   /* Per-frame replacement descriptors, allocated on first enlist */
+   struct pgn_t *pgdesc;
+
+   /* Shared read-only zero frame, PAGING_FPN_NIL until first used */
+   addr_t zerofpn;
+
+   /* Frame to host buffer table, NULL when frames sit in storage order */
+   BYTE **frames;
 
    pthread_mutex_t lock;
 };
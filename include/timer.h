@@ -7,6 +7,7 @@
 struct timer_id_t {
 	int done;
 	int fsh;
+	int daemon;	/* does not keep the timer alive, fsh is set on stop */
 	pthread_cond_t event_cond;
 	pthread_mutex_t event_lock;
 	pthread_cond_t timer_cond;
@@ -19,6 +20,8 @@ void stop_timer();
 
 struct timer_id_t * attach_event();
 
+struct timer_id_t * attach_daemon();
+
 void detach_event(struct timer_id_t * event);
 
 void next_slot(struct timer_id_t* timer_id);
@@ -25,6 +25,9 @@
 
 static pthread_mutex_t mmvm_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/* Shared memory segments by key, guarded by mmvm_lock */
+static struct shm_segment *shm_list;
+
 /*enlist_vm_freerg_list - add new rg to freerg_list
  *@mm: memory region
  *@rg_elmt: new region
@@ -212,278 +215,1776 @@ printf("%s:%d\n",__func__,__LINE__);
   return 0;//val;
 }
 
-/*pg_getpage - get the page in ram
+/*pg_get_vma - vm area holding a page
  *@mm: memory region
- *@pagenum: PGN
- *@framenum: return FPN
- *@caller: caller
+ *@pgn: PGN
  *
  */
-int pg_getpage(struct mm_struct *mm, int pgn, int *fpn, struct pcb_t *caller)
+static struct vm_area_struct *pg_get_vma(struct mm_struct *mm, addr_t pgn)
 {
+  struct vm_area_struct *vma;
+  addr_t addr = pgn * PAGING_PAGESZ;
 
-  uint32_t pte = pte_get_entry(caller, pgn);
+  for (vma = mm->mmap; vma != NULL; vma = vma->vm_next)
+    if (vma->vm_start <= addr && addr < vma->vm_end)
+      return vma;
 
-  if (!PAGING_PAGE_PRESENT(pte))
-  { /* Page is not online, make it actively living */
-    addr_t vicpgn, swpfpn;
-//    addr_t vicfpn;
-//    addr_t vicpte;
-//  struct sc_regs regs;
+  return NULL;
+}
 
-    /* TODO Initialize the target frame storing our variable */
-//  addr_t tgtfpn 
+#ifdef MM_ZSWAP
+/*pg_zswap_store - compress a RAM frame into the swap pool
+ *@krnl: kernel
+ *@fpn: frame
+ *@idx: return pool entry
+ *
+ */
+static int pg_zswap_store(struct krnl_t *krnl, addr_t fpn, addr_t *idx)
+{
+  BYTE page[PAGING_PAGESZ];
 
-    /* TODO: Play with your paging theory here */
-    /* Find victim page */
-    if (find_victim_page(caller->krnl->mm, &vicpgn) == -1)
-    {
-      return -1;
-    }
+  MEMPHY_read_block(krnl->mram, fpn * PAGING_PAGESZ, page, PAGING_PAGESZ);
+  return zswap_store(&krnl->swap->zpool, page, idx);
+}
+#endif
 
-    /* Get free frame in MEMSWP */
-    if (MEMPHY_get_freefp(caller->krnl->active_mswp, &swpfpn) == -1)
-    {
-      return -1;
-    }
+/*pg_swap_write - write a page to a swap slot of its own
+ *@krnl: kernel
+ *@page: page content
+ *@swptyp: return swap type
+ *@swpoff: return swap offset
+ *
+ * The compressed pool is tried before the swap devices.
+ */
+static int pg_swap_write(struct krnl_t *krnl, const BYTE *page, int *swptyp, addr_t *swpoff)
+{
+#ifdef MM_ZSWAP
+  if (zswap_store(&krnl->swap->zpool, page, swpoff) == 0)
+  {
+    *swptyp = PAGING_SWP_ZSWAP;
+    return 0;
+  }
+#endif
 
-    /* TODO: Implement swap frame from MEMRAM to MEMSWP and vice versa*/
+  if (swap_alloc(krnl->swap, swptyp, swpoff) == -1)
+    return -1;
 
-    /* TODO copy victim frame to swap 
-     * SWP(vicfpn <--> swpfpn)
-     * SYSCALL 1 sys_memmap
-     */
+  if (MEMPHY_write_block(swap_dev(krnl->swap, *swptyp), *swpoff * PAGING_PAGESZ,
+                         page, PAGING_PAGESZ) < 0)
+  {
+    swap_free(krnl->swap, *swptyp, *swpoff);
+    return -1;
+  }
 
+  return 0;
+}
 
-    /* Update page table */
-    //pte_set_swap(...);
+/* Visit of a mapper by pg_rmap_walk(), a nonzero return stops the walk */
+typedef int (*pg_rmap_fn)(struct pcb_t *mapper, addr_t pgn, void *arg);
 
-    /* Update its online status of the target page */
-    //pte_set_fpn(...);
+/*pg_rmap_walk - visit the other mappers of a resident page
+ *@caller: caller, it maps the page at @pgn
+ *@pgn: PGN
+ *@fpn: frame of the page
+ *@fn: visit, called with a kernel context on the mapper's mm
+ *@arg: argument of @fn
+ *
+ * A page of a shared memory segment is mapped by every attachment of
+ * the segment at its own address. Fork keeps the addresses, so the other
+ * mappers of a frame shared by fork are the mms whose PTE of @pgn holds
+ * @fpn. Returns the value that stopped the walk, 0 if none did.
+ */
+static int pg_rmap_walk(struct pcb_t *caller, addr_t pgn, addr_t fpn,
+                        pg_rmap_fn fn, void *arg)
+{
+  struct vm_area_struct *vma = pg_get_vma(caller->krnl->mm, pgn);
+  struct krnl_t krnl = *caller->krnl;
+  struct pcb_t kthread;
+  struct shm_attach *at;
+  struct mm_struct *mm = NULL;
+  addr_t idx, pte;
+  int ret;
+
+  kthread.krnl = &krnl;
+  kthread.pid = 0;
+
+  if (vma != NULL && vma->vm_shm != NULL)
+  {
+    idx = pgn - vma->vm_start / PAGING_PAGESZ;
+    for (at = vma->vm_shm->attach; at != NULL; at = at->next)
+    {
+      if (at->mm == caller->krnl->mm && at->pgn + idx == pgn)
+        continue;
 
-    enlist_pgn_node(&caller->krnl->mm->fifo_pgn, pgn);
+      krnl.mm = at->mm;
+      if ((ret = fn(&kthread, at->pgn + idx, arg)) != 0)
+        return ret;
+    }
+    return 0;
   }
 
-  *fpn = PAGING_FPN(pte_get_entry(caller,pgn));
+  if (pgn_desc(caller->krnl->mram, fpn)->pg_mapcount == 0)
+    return 0;
+
+  while ((mm = mmlist_next(mm)) != NULL)
+  {
+    if (mm == caller->krnl->mm)
+      continue;
+
+    krnl.mm = mm;
+    pte = pte_get_entry(&kthread, pgn);
+    if (!PAGING_PAGE_PRESENT(pte) || (pte & PAGING_PTE_SWAPPED_MASK) ||
+        PAGING_FPN(pte) != fpn)
+      continue;
+
+    if ((ret = fn(&kthread, pgn, arg)) != 0)
+      return ret;
+  }
 
   return 0;
 }
 
-/*pg_getval - read value at given offset
- *@mm: memory region
- *@addr: virtual address to acess
- *@value: value
- *
- */
-int pg_getval(struct mm_struct *mm, int addr, BYTE *data, struct pcb_t *caller)
+/* Visits of pg_rmap_walk(), the first mapper is returned in a pg_rmap_ref */
+struct pg_rmap_ref {
+  struct mm_struct *mm;
+  addr_t pgn;
+};
+
+static int pg_rmap_first(struct pcb_t *mapper, addr_t pgn, void *arg)
 {
-  int pgn = PAGING_PGN(addr);
-//  int off = PAGING_OFFST(addr);
-  int fpn;
+  struct pg_rmap_ref *ref = arg;
 
-  if (pg_getpage(mm, pgn, &fpn, caller) != 0)
-    return -1; /* invalid page access */
+  ref->mm = mapper->krnl->mm;
+  ref->pgn = pgn;
+  return 1;
+}
 
-//  int phyaddr = (fpn << PAGING_ADDR_FPN_LOBIT) + off;
+static int pg_rmap_set_fpn(struct pcb_t *mapper, addr_t pgn, void *arg)
+{
+  pte_set_fpn(mapper, pgn, *(addr_t *)arg);
+  return 0;
+}
 
-  /* TODO 
-   *  MEMPHY_read(caller->krnl->mram, phyaddr, data);
-   *  MEMPHY READ 
-   *  SYSCALL 17 sys_memmap with SYSMEM_IO_READ
-   */
+static int pg_rmap_set_swap(struct pcb_t *mapper, addr_t pgn, void *arg)
+{
+  addr_t *swp = arg;
 
+  pte_set_swap(mapper, pgn, (int)swp[0], swp[1]);
   return 0;
 }
 
-/*pg_setval - write value to given offset
- *@mm: memory region
- *@addr: virtual address to acess
- *@value: value
+static int pg_rmap_dirty(struct pcb_t *mapper, addr_t pgn, void *arg)
+{
+  *(addr_t *)arg |= pte_get_entry(mapper, pgn) & PAGING_PTE_DIRTY_MASK;
+  return 0;
+}
+
+/*pg_enlist_mm - track a resident page on the lists of another mm
+ *@caller: caller
+ *@mm: mm to track the page, nothing is done for NULL
+ *@pgn: PGN
+ *@fpn: frame of the page
  *
  */
-int pg_setval(struct mm_struct *mm, int addr, BYTE value, struct pcb_t *caller)
+static void pg_enlist_mm(struct pcb_t *caller, struct mm_struct *mm, addr_t pgn, addr_t fpn)
 {
-  int pgn = PAGING_PGN(addr);
-//  int off = PAGING_OFFST(addr);
-  int fpn;
+  struct krnl_t krnl = *caller->krnl;
+  struct pcb_t kthread;
 
-  /* Get the page to MEMRAM, swap from MEMSWAP if needed */
-  if (pg_getpage(mm, pgn, &fpn, caller) != 0)
-    return -1; /* invalid page access */
+  if (mm == NULL)
+    return;
 
+  krnl.mm = mm;
+  kthread.krnl = &krnl;
+  kthread.pid = 0;
+  enlist_pgn_node(&kthread, pgn, fpn);
+}
 
-  /* TODO 
-   *  MEMPHY_write(caller->krnl->mram, phyaddr, value);
-   *  MEMPHY WRITE with SYSMEM_IO_WRITE 
-   * SYSCALL 17 sys_memmap
-   */
+/*pg_handoff - let another mapper track a page the caller gives up
+ *@caller: caller
+ *@pgn: PGN of the page in the caller
+ *@fpn: frame of the page
+ *
+ */
+static void pg_handoff(struct pcb_t *caller, addr_t pgn, addr_t fpn)
+{
+  struct pg_rmap_ref ref;
 
-  return 0;
+  if (pg_rmap_walk(caller, pgn, fpn, pg_rmap_first, &ref) != 0)
+    pg_enlist_mm(caller, ref.mm, ref.pgn, fpn);
 }
 
-/*__read - read value in region memory
+/*pg_set_swap - point every mapper of an evicted page at its swap copy
  *@caller: caller
- *@vmaid: ID vm area to alloc memory region
- *@offset: offset to acess in memory region
- *@rgid: memory region ID (used to identify variable in symbole table)
- *@size: allocated size
+ *@pgn: PGN
+ *@fpn: frame the page leaves
+ *@swptyp: swap type
+ *@swpoff: swap offset
  *
  */
-int __read(struct pcb_t *caller, int vmaid, int rgid, addr_t offset, BYTE *data)
+static void pg_set_swap(struct pcb_t *caller, addr_t pgn, addr_t fpn, int swptyp, addr_t swpoff)
 {
-  struct vm_rg_struct *currg = get_symrg_byid(caller->krnl->mm, rgid);
+  addr_t swp[2] = { (addr_t)swptyp, swpoff };
 
-//  struct vm_area_struct *cur_vma = get_vma_by_num(caller->krnl->mm, vmaid);
+  pg_rmap_walk(caller, pgn, fpn, pg_rmap_set_swap, swp);
+  pte_set_swap(caller, pgn, swptyp, swpoff);
+}
 
-  /* TODO Invalid memory identify */
+/* Visit of pg_unshare(), a swap copy of its own for the mapper */
+static int pg_rmap_unshare(struct pcb_t *mapper, addr_t pgn, void *arg)
+{
+  struct pgn_t *desc = pgn_desc(mapper->krnl->mram, PAGING_FPN(pte_get_entry(mapper, pgn)));
+  addr_t swpoff;
+  int swptyp;
 
-  pg_getval(caller->krnl->mm, currg->rg_start + offset, data, caller);
+  if (pg_swap_write(mapper->krnl, arg, &swptyp, &swpoff) != 0)
+    return -1;
 
+  pte_set_swap(mapper, pgn, swptyp, swpoff);
+  desc->pg_mapcount--;
   return 0;
 }
 
-/*libread - PAGING-based read a region memory */
-int libread(
-    struct pcb_t *proc, // Process executing the instruction
-    uint32_t source,    // Index of source register
-    addr_t offset,    // Source address = [source] + [offset]
-    uint32_t* destination)
+/*pg_unshare - swap out the other mappers of a victim shared by fork
+ *@caller: caller, it maps and tracks the victim
+ *@pgn: victim PGN
+ *@fpn: victim frame
+ *
+ * Every other mapper gets a swap copy of its own, the frame is left
+ * private to the caller and its eviction goes the usual way.
+ */
+static int pg_unshare(struct pcb_t *caller, addr_t pgn, addr_t fpn)
 {
-  BYTE data;
-  int val = __read(proc, 0, source, offset, &data);
+  BYTE page[PAGING_PAGESZ];
+  struct pgn_t *desc = pgn_desc(caller->krnl->mram, fpn);
 
-  *destination = data;
-#ifdef IODUMP
-  /* TODO dump IO content (if needed) */
-#ifdef PAGETBL_DUMP
-  print_pgtbl(proc, 0, -1); // print max TBL
-#endif
-#endif
+  if (desc->pg_mapcount == 0)
+    return 0;
 
-  return val;
+  MEMPHY_read_block(caller->krnl->mram, fpn * PAGING_PAGESZ, page, PAGING_PAGESZ);
+  if (pg_rmap_walk(caller, pgn, fpn, pg_rmap_unshare, page) != 0)
+    return -1;
+
+  desc->pg_mapcount = 0;
+  return 0;
 }
 
-/*__write - write a region memory
+/*pg_evict_nowrite - evict a victim that needs no swap device write
  *@caller: caller
- *@vmaid: ID vm area to alloc memory region
- *@offset: offset to acess in memory region
- *@rgid: memory region ID (used to identify variable in symbole table)
- *@size: allocated size
+ *@vicpgn: victim PGN
+ *@vicpte: victim PTE
  *
+ * A clean page still in the swap cache goes back to its slot, any other
+ * page without a swap copy is offered to the compressed pool. A dirty
+ * page moves back to its slot too when the devices exchange frames.
  */
-int __write(struct pcb_t *caller, int vmaid, int rgid, addr_t offset, BYTE value)
+static int pg_evict_nowrite(struct pcb_t *caller, addr_t vicpgn, addr_t vicpte)
 {
-  pthread_mutex_lock(&mmvm_lock);
-  struct vm_rg_struct *currg = get_symrg_byid(caller->krnl->mm, rgid);
+  struct krnl_t *krnl = caller->krnl;
+  addr_t vicfpn = PAGING_FPN(vicpte), swpfpn;
+  struct pgn_t *vicdesc = pgn_desc(krnl->mram, vicfpn);
+  struct memphy_struct *dev;
+  int swptyp;
 
-  struct vm_area_struct *cur_vma = get_vma_by_num(caller->krnl->mm, vmaid);
+  /* A write through any mapper of a shared page dirties it */
+  pg_rmap_walk(caller, vicpgn, vicfpn, pg_rmap_dirty, &vicpte);
 
-  if (currg == NULL || cur_vma == NULL) /* Invalid memory identify */
+  if (vicdesc->pg_swcache)
   {
-    pthread_mutex_unlock(&mmvm_lock);
-    return -1;
-  }
+    swptyp = vicdesc->pg_swptyp;
+    swpfpn = vicdesc->pg_swpoff;
+    dev = swap_dev(krnl->swap, swptyp);
 
-  pg_setval(caller->krnl->mm, currg->rg_start + offset, value, caller);
+    if ((vicpte & PAGING_PTE_DIRTY_MASK) &&
+        (krnl->mram->frames == NULL || dev->frames == NULL ||
+         __swap_mv_page(krnl->mram, vicfpn, dev, swpfpn) != 1))
+      return -1;
+  }
+#ifdef MM_ZSWAP
+  else if (!vicdesc->pg_swcache && pg_zswap_store(krnl, vicfpn, &swpfpn) == 0)
+    swptyp = PAGING_SWP_ZSWAP;
+#endif
+  else
+    return -1;
 
-  pthread_mutex_unlock(&mmvm_lock);
+  vicdesc->pg_swcache = 0;
+  vicdesc->pg_ra = 0;
+  pg_set_swap(caller, vicpgn, vicfpn, swptyp, swpfpn);
   return 0;
 }
 
-/*libwrite - PAGING-based write a region memory */
-int libwrite(
-    struct pcb_t *proc,   // Process executing the instruction
-    BYTE data,            // Data to be wrttien into memory
-    uint32_t destination, // Index of destination register
-    addr_t offset)
+/*pg_evict - swap out a victim page and take over its frame
+ *@caller: caller
+ *@retfpn: return FPN
+ *
+ */
+static int pg_evict(struct pcb_t *caller, addr_t *retfpn)
 {
-  int val = __write(proc, 0, destination, offset, data);
-  if (val == -1)
+  struct krnl_t *krnl = caller->krnl;
+  addr_t vicpgn, vicfpn, vicpte, swpfpn;
+  int swptyp;
+  struct pgn_t *vicdesc;
+  struct sc_regs regs;
+
+  /* Find victim page */
+  if (find_victim_page(caller, &vicpgn) == -1)
+    return -1;
+
+  vicpte = pte_get_entry(caller, vicpgn);
+  vicfpn = PAGING_FPN(vicpte);
+  vicdesc = pgn_desc(krnl->mram, vicfpn);
+
+  if (pg_unshare(caller, vicpgn, vicfpn) != 0)
   {
+    enlist_pgn_node(caller, vicpgn, vicfpn);
     return -1;
   }
-#ifdef IODUMP
-#ifdef PAGETBL_DUMP
-  printf("libwrite:%d\n", __LINE__);
-  print_pgtbl(proc, 0, -1); // print max TBL
-#endif
-  MEMPHY_dump(proc->krnl->mram);
-#endif
 
-  return val;
+  if (pg_evict_nowrite(caller, vicpgn, vicpte) == 0)
+  {
+    *retfpn = vicfpn;
+    return 0;
+  }
+
+  /* Rewrite the slot of a dirty swap cached page, else get a free slot
+   * on one of the swap devices */
+  if (vicdesc->pg_swcache)
+  {
+    swptyp = vicdesc->pg_swptyp;
+    swpfpn = vicdesc->pg_swpoff;
+  }
+  else if (swap_alloc(krnl->swap, &swptyp, &swpfpn) == -1)
+  {
+    enlist_pgn_node(caller, vicpgn, vicfpn);
+    return -1;
+  }
+
+  /* Copy victim frame to swap
+   * SWP(vicfpn <--> swpfpn)
+   * SYSCALL 17 sys_memmap
+   */
+  regs.a1 = SYSMEM_SWP_OP;
+  regs.a2 = vicfpn;
+  regs.a3 = swpfpn;
+  regs.a4 = swptyp;
+  syscall(krnl, caller->pid, 17, &regs);
+
+  vicdesc->pg_swcache = 0;
+  vicdesc->pg_ra = 0;
+
+  /* Update page table */
+  pg_set_swap(caller, vicpgn, vicfpn, swptyp, swpfpn);
+
+  *retfpn = vicfpn;
+  return 0;
 }
 
-/*free_pcb_memphy - collect all memphy of pcb
- *@caller: caller
- *@vmaid: ID vm area to alloc memory region
- *@incpgnum: number of page
+/*pg_evict_batch - swap out a batch of victims to adjacent swap slots
+ *@caller: kernel context of the reclaim daemon
+ *@n: number of victims, at most PAGING_SWAP_BATCH
+ *@fpns: return the freed frames
+ *
+ * Victims that need a device write are gathered and written to a run
+ * of adjacent slots with one block write per run, so a sequential swap
+ * device moves its cursor once per run instead of once per page.
+ * Returns the number of frames freed.
  */
-int free_pcb_memph(struct pcb_t *caller)
+static int pg_evict_batch(struct pcb_t *caller, int n, addr_t *fpns)
 {
-  pthread_mutex_lock(&mmvm_lock);
+  BYTE buf[PAGING_SWAP_BATCH * PAGING_PAGESZ];
+  struct krnl_t *krnl = caller->krnl;
+  addr_t pgns[PAGING_SWAP_BATCH];
+  addr_t vicpgn, vicpte, swpoff;
+  struct memphy_struct *dev;
+  struct pgn_t *desc;
+  int nr = 0, nwr = 0, i, j, cnt, swptyp;
+
+  /* Pick the victims, the cheap ones are done at once */
+  while (nr + nwr < n && find_victim_page(caller, &vicpgn) == 0)
+  {
+    vicpte = pte_get_entry(caller, vicpgn);
+    if (pg_unshare(caller, vicpgn, PAGING_FPN(vicpte)) != 0)
+    {
+      enlist_pgn_node(caller, vicpgn, PAGING_FPN(vicpte));
+      break;
+    }
 
-  struct mm_struct *mm = caller->krnl->mm;
-  struct pgn_t *node = mm->fifo_pgn;
+    if (pg_evict_nowrite(caller, vicpgn, vicpte) == 0)
+    {
+      fpns[nr++] = PAGING_FPN(vicpte);
+      continue;
+    }
+    pgns[nwr++] = vicpgn;
+  }
 
-  while (node != NULL)
+  /* Write the rest out run by run */
+  i = 0;
+  while (i < nwr)
   {
-    addr_t pgn = node->pgn;
-    uint32_t pte = pte_get_entry(caller, pgn);
+    cnt = swap_alloc_n(krnl->swap, nwr - i, &swptyp, &swpoff);
+    if (cnt < 0)
+      break;
+    dev = swap_dev(krnl->swap, swptyp);
 
-    if (PAGING_PAGE_PRESENT(pte))
+    if (krnl->mram->frames != NULL && dev->frames != NULL)
     {
-      if (!PAGING_PTE_SWP(pte)) {
-        addr_t fpn = PAGING_FPN(pte);
-        MEMPHY_put_freefp(caller->krnl->mram, fpn);
-      } 
-      else {
-        addr_t swp_off = PAGING_SWP(pte);
-        MEMPHY_put_freefp(caller->krnl->active_mswp, swp_off);
-      }
+      /* Frame-indirected devices take the pages without a copy */
+      for (j = 0; j < cnt; j++)
+        __swap_mv_page(krnl->mram, PAGING_FPN(pte_get_entry(caller, pgns[i + j])),
+                       dev, swpoff + j);
+    }
+    else
+    {
+      for (j = 0; j < cnt; j++)
+        MEMPHY_read_block(krnl->mram, PAGING_FPN(pte_get_entry(caller, pgns[i + j])) * PAGING_PAGESZ,
+                          buf + j * PAGING_PAGESZ, PAGING_PAGESZ);
+      MEMPHY_write_block(dev, swpoff * PAGING_PAGESZ, buf, cnt * PAGING_PAGESZ);
     }
 
-    struct pgn_t *tmp = node;
-    node = node->pg_next;
-    free(tmp);
+    for (j = 0; j < cnt; j++, i++)
+    {
+      vicpte = pte_get_entry(caller, pgns[i]);
+      desc = pgn_desc(krnl->mram, PAGING_FPN(vicpte));
+
+      /* A dirty swap cached page moved to the new run */
+      if (desc->pg_swcache)
+        swap_free(krnl->swap, desc->pg_swptyp, desc->pg_swpoff);
+      desc->pg_swcache = 0;
+      desc->pg_ra = 0;
+
+      pg_set_swap(caller, pgns[i], PAGING_FPN(vicpte), swptyp, swpoff + j);
+      fpns[nr++] = PAGING_FPN(vicpte);
+    }
   }
 
-  mm->fifo_pgn = NULL;
+  /* Out of swap, the rest stay resident */
+  for (; i < nwr; i++)
+    enlist_pgn_node(caller, pgns[i], PAGING_FPN(pte_get_entry(caller, pgns[i])));
 
-  pthread_mutex_unlock(&mmvm_lock);
-  return 0;
+  return nr;
 }
 
+/*pg_evict_other - swap out a page of another mm and take over its frame
+ *@caller: caller
+ *@retfpn: return FPN
+ *
+ * For a caller without resident pages to give up, e.g. a child right
+ * after fork whose frames are all still shared with its parent.
+ */
+static int pg_evict_other(struct pcb_t *caller, addr_t *retfpn)
+{
+  struct krnl_t krnl = *caller->krnl;
+  struct pcb_t kthread;
+  struct mm_struct *mm = NULL;
+
+  /* Kernel context on the other mm, only the kernel and pid fields are used */
+  kthread.krnl = &krnl;
+  kthread.pid = 0;
+
+  while ((mm = mmlist_next(mm)) != NULL)
+  {
+    if (mm == caller->krnl->mm)
+      continue;
 
+    krnl.mm = mm;
+    if (pg_evict_batch(&kthread, 1, retfpn) == 1)
+      return 0;
+  }
 
-/*find_victim_page - find victim page
+  return -1;
+}
+
+/*pg_getframe - get a RAM frame, evict a victim page if RAM is full
  *@caller: caller
- *@pgn: return page number
+ *@retfpn: return FPN
  *
  */
-int find_victim_page(struct mm_struct *mm, addr_t *retpgn)
+static int pg_getframe(struct pcb_t *caller, addr_t *retfpn)
 {
-  struct pgn_t *pg = mm->fifo_pgn;
+  if (MEMPHY_get_freefp(caller->krnl->mram, retfpn) == 0)
+    return 0;
 
-  if (!pg)
-    return -1; 
+  if (pg_evict(caller, retfpn) == 0)
+    return 0;
+
+  return pg_evict_other(caller, retfpn);
+}
+
+/*pg_reclaim - background reclaim, keep RAM free frames between the
+ *             low and high watermarks
+ *@krnl: kernel
+ *
+ * Called by the reclaim daemon once per time slot. Nothing happens while
+ * the free frames stay at or above the low watermark, below it victims of
+ * the configured policy are swapped out in batches until the high
+ * watermark is met. Every mm gives up one batch per round so RAM shared
+ * by several processes is not reclaimed from a single one. Returns the
+ * number of frames reclaimed.
+ */
+int pg_reclaim(struct krnl_t *krnl)
+{
+  struct krnl_t kctx;
+  struct pcb_t kthread;
+  struct mm_struct *mm;
+  addr_t numfp, low, high, nrfree, want;
+  addr_t fpns[PAGING_SWAP_BATCH];
+  int nr = 0, round, got, i;
+
+  if (krnl->mram == NULL || krnl->swap == NULL)
+    return 0;
 
-  if (pg->pg_next == NULL) {
-    *retpgn = pg->pgn;
-    mm->fifo_pgn = NULL;  
-    free(pg);
+  numfp = krnl->mram->maxsz / PAGING_PAGESZ;
+  low = numfp / PAGING_WMARK_LOW_DIV;
+  high = numfp / PAGING_WMARK_HIGH_DIV;
+  if (low < 1)
+    low = 1;
+  if (high <= low)
+    high = low + 1;
+
+  if (MEMPHY_get_nrfree(krnl->mram) >= low)
     return 0;
+
+  /* Kernel context on each mm in turn, only the kernel and pid fields are used */
+  kctx = *krnl;
+  kthread.krnl = &kctx;
+  kthread.pid = 0;
+
+  pthread_mutex_lock(&mmvm_lock);
+  nrfree = MEMPHY_get_nrfree(krnl->mram);
+  printf("\tkswapd: wake at " FORMAT_ADDR " free frames, low watermark " FORMAT_ADDR "\n",
+         nrfree, low);
+  while (nrfree < high)
+  {
+    round = 0;
+    mm = NULL;
+    while (nrfree < high && (mm = mmlist_next(mm)) != NULL)
+    {
+      want = (high - nrfree < PAGING_SWAP_BATCH) ? high - nrfree : PAGING_SWAP_BATCH;
+      kctx.mm = mm;
+      got = pg_evict_batch(&kthread, want, fpns);
+      for (i = 0; i < got; i++)
+        MEMPHY_put_freefp(krnl->mram, fpns[i]);
+      round += got;
+      nrfree += got;
+    }
+
+    /* Nothing left to evict in any mm */
+    if (round == 0)
+      break;
+    nr += round;
+    nrfree = MEMPHY_get_nrfree(krnl->mram);
+  }
+  printf("\tkswapd: sleep at " FORMAT_ADDR " free frames, high watermark " FORMAT_ADDR
+         ", %d reclaimed\n", nrfree, high, nr);
+  pthread_mutex_unlock(&mmvm_lock);
+
+  return nr;
+}
+
+/*pg_swapin - copy a swapped page into a RAM frame and map it
+ *@caller: caller
+ *@pgn: PGN
+ *@pte: swapped PTE of the page
+ *@tgtfpn: target frame
+ *
+ */
+static void pg_swapin(struct pcb_t *caller, addr_t pgn, addr_t pte, addr_t tgtfpn)
+{
+  struct memphy_struct *mram = caller->krnl->mram;
+  addr_t swpfpn = PAGING_SWP(pte);
+  int swptyp = PAGING_SWPTYP(pte);
+  struct pgn_t *desc;
+  int swcache = 1, stale = 0;
+
+  if (swptyp == PAGING_SWP_ZSWAP)
+  {
+    /* A pooled page leaves the pool, keeping both copies saves nothing */
+    BYTE page[PAGING_PAGESZ];
+
+    zswap_load(&caller->krnl->swap->zpool, swpfpn, page);
+    zswap_free(&caller->krnl->swap->zpool, swpfpn);
+    MEMPHY_write_block(mram, tgtfpn * PAGING_PAGESZ, page, PAGING_PAGESZ);
+    swcache = 0;
+  }
+  else
+  {
+    /* Swap the page back in, its swap frame stays reserved in the swap
+     * cache until the page is written and evicted or released. After a
+     * buffer exchange the slot holds no copy, the page counts as dirty
+     * so its eviction moves it back in */
+    stale = __swap_mv_page(swap_dev(caller->krnl->swap, swptyp), swpfpn, mram, tgtfpn) == 1;
   }
 
-  struct pgn_t *prev = NULL;
-  while (pg->pg_next != NULL)
+  /* Update its online status of the target page, on every mapper of a
+   * shared memory page */
+  pte_set_fpn(caller, pgn, tgtfpn);
+  pg_rmap_walk(caller, pgn, tgtfpn, pg_rmap_set_fpn, &tgtfpn);
+  if (stale)
+    pte_set_bits(caller, pgn, PAGING_PTE_DIRTY_MASK);
+
+  enlist_pgn_node(caller, pgn, tgtfpn);
+  desc = pgn_desc(mram, tgtfpn);
+  desc->pg_swcache = swcache;
+  desc->pg_swptyp = swptyp;
+  desc->pg_swpoff = swpfpn;
+  desc->pg_ra = 0;
+}
+
+#ifdef MM_SWAP_READAHEAD
+/*pg_readahead - swap in the swapped pages following a faulting one
+ *@caller: caller
+ *@pgn: PGN of the demand swap-in
+ *
+ * Runs while the faulting page holds its target frame but is not mapped
+ * yet, frames for the readahead pages may evict older pages. The window
+ * is capped to a quarter of RAM so a guess never flushes the working set.
+ */
+static void pg_readahead(struct pcb_t *caller, addr_t pgn)
+{
+  struct mm_struct *mm = caller->krnl->mm;
+  struct vm_area_struct *vma = pg_get_vma(mm, pgn);
+  addr_t endpgn, pte, fpn, i, maxwin;
+
+  /* Widen the window while readahead pages get used, else narrow it */
+  if (mm->ra.issued > 0)
   {
-    prev = pg;
-    pg = pg->pg_next;
+    if (2 * mm->ra.hits >= mm->ra.issued)
+      mm->ra.win = (2 * mm->ra.win < PAGING_RA_MAX) ? 2 * mm->ra.win : PAGING_RA_MAX;
+    else if (mm->ra.win > 1)
+      mm->ra.win /= 2;
   }
+  mm->ra.hits = 0;
+  mm->ra.issued = 0;
 
-  *retpgn = pg->pgn;
-  prev->pg_next = NULL;   
-  free(pg);
+  if (vma == NULL)
+    return;
+
+  endpgn = vma->vm_end / PAGING_PAGESZ;
+  maxwin = caller->krnl->mram->maxsz / PAGING_PAGESZ / 4;
+
+  for (i = 1; i <= mm->ra.win && i <= maxwin && pgn + i < endpgn; i++)
+  {
+    pte = pte_get_entry(caller, pgn + i);
+    if (!PAGING_PAGE_PRESENT(pte) || !(pte & PAGING_PTE_SWAPPED_MASK))
+      continue;
+
+    if (pg_getframe(caller, &fpn) != 0)
+      break;
+
+    pg_swapin(caller, pgn + i, pte, fpn);
+    pgn_desc(caller->krnl->mram, fpn)->pg_ra = 1;
+    mm->ra.issued++;
+  }
+}
+#endif
+
+#ifdef MM_FAULT_AROUND
+/*pg_fault_around - map the untouched neighbours of a first-touch fault
+ *@caller: caller
+ *@pgn: PGN of the fault
+ *@zerofpn: zero frame
+ *
+ */
+static void pg_fault_around(struct pcb_t *caller, addr_t pgn, addr_t zerofpn)
+{
+  struct vm_area_struct *vma = pg_get_vma(caller->krnl->mm, pgn);
+  addr_t start = pgn & ~((addr_t)PAGING_FAULT_AROUND - 1);
+  addr_t end = start + PAGING_FAULT_AROUND;
+
+  if (vma == NULL)
+    return;
+
+  /* Stay inside the vm area */
+  if (start < vma->vm_start / PAGING_PAGESZ)
+    start = vma->vm_start / PAGING_PAGESZ;
+  if (end > vma->vm_end / PAGING_PAGESZ)
+    end = vma->vm_end / PAGING_PAGESZ;
+
+  vmap_zero_range(caller, start, end - start, zerofpn);
+}
+#endif
+
+static const BYTE zeropg[PAGING_PAGESZ];
+
+/*pg_getzero - get the shared zero frame of RAM
+ *@caller: caller
+ *@retfpn: return FPN
+ *
+ * The frame is taken on first use and never written afterwards.
+ */
+static int pg_getzero(struct pcb_t *caller, addr_t *retfpn)
+{
+  struct memphy_struct *mram = caller->krnl->mram;
+  addr_t fpn;
+
+  if (mram->zerofpn == PAGING_FPN_NIL)
+  {
+    if (pg_getframe(caller, &fpn) == -1)
+      return -1;
+
+    MEMPHY_write_block(mram, fpn * PAGING_PAGESZ, zeropg, PAGING_PAGESZ);
+    mram->zerofpn = fpn;
+  }
+
+  *retfpn = mram->zerofpn;
+  return 0;
+}
+
+#if defined(MM64) && defined(MM_HUGEPAGE)
+/*pg_huge_fault - back a first-touch fault with a huge mapping
+ *@caller: caller
+ *@vma: vm area of the fault
+ *@pgn: PGN of the fault
+ *
+ * Only when the aligned PMD range lies inside the vm area and none of
+ * its pages was touched yet. The run is zeroed like a fresh page.
+ */
+static int pg_huge_fault(struct pcb_t *caller, struct vm_area_struct *vma, addr_t pgn)
+{
+  addr_t base = pgn & ~((addr_t)PAGING64_HUGE_PGNUM - 1);
+  addr_t pte, i;
+
+  if (base < vma->vm_start / PAGING_PAGESZ ||
+      base + PAGING64_HUGE_PGNUM > vma->vm_end / PAGING_PAGESZ)
+    return -1;
+
+  if (vmap_huge_page(caller, base) != 0 || pte_lookup(caller, base, &pte) != 1)
+    return -1;
+
+  for (i = 0; i < PAGING64_HUGE_PGNUM; i++)
+    MEMPHY_write_block(caller->krnl->mram, (PAGING_FPN(pte) + i) * PAGING_PAGESZ,
+                       zeropg, PAGING_PAGESZ);
+
+  return 0;
+}
+#endif
+
+/*pg_shm_fault - first touch of a shared memory page
+ *@caller: caller
+ *@pgn: PGN
+ *
+ * Writes must reach every attachment, so the page gets a zeroed frame of
+ * its own right away and every attachment maps it.
+ */
+static int pg_shm_fault(struct pcb_t *caller, addr_t pgn)
+{
+  addr_t fpn;
+
+  if (pg_getframe(caller, &fpn) == -1)
+    return -1;
+
+  MEMPHY_write_block(caller->krnl->mram, fpn * PAGING_PAGESZ, zeropg, PAGING_PAGESZ);
+  pte_set_fpn(caller, pgn, fpn);
+  pg_rmap_walk(caller, pgn, fpn, pg_rmap_set_fpn, &fpn);
+  enlist_pgn_node(caller, pgn, fpn);
+
+  return 0;
+}
+
+/*__pg_getpage - get the page in ram
+ *@mm: memory region
+ *@pagenum: PGN
+ *@retpte: return PTE of the online page
+ *@caller: caller
+ *
+ * A page that was never touched is mapped read-only to the shared zero
+ * frame (demand paging), a swapped page is brought back from MEMSWP.
+ */
+static int __pg_getpage(struct mm_struct *mm, addr_t pgn, addr_t *retpte, struct pcb_t *caller)
+{
+  addr_t tlbpte;
+
+  /* Fast path, translation cached by this CPU */
+  if (tlb_lookup(mm, caller->pid, pgn, &tlbpte) == 0)
+  {
+    /* First reference after the page came in */
+    if (!(tlbpte & PAGING_PTE_ACCESSED_MASK) &&
+        pte_set_bits(caller, pgn, PAGING_PTE_ACCESSED_MASK) == 0)
+    {
+      SETBIT(tlbpte, PAGING_PTE_ACCESSED_MASK);
+      tlb_fill(mm, caller->pid, pgn, tlbpte);
+    }
+
+    *retpte = tlbpte;
+    return 0;
+  }
+
+#ifdef MM64
+  addr_t hpte;
+
+  /* A huge mapping is always resident, one TLB entry covers all of it */
+  if (pte_lookup(caller, pgn, &hpte) == 1)
+  {
+    *retpte = hpte;
+    tlb_fill_huge(mm, caller->pid, pgn, hpte, PAGING64_HUGE_ORDER);
+    return 0;
+  }
+#endif
+
+  addr_t pte = pte_get_entry(caller, pgn);
+  struct vm_area_struct *vma;
+  int faulted = 0;
+
+  if (!PAGING_PAGE_PRESENT(pte) && (vma = pg_get_vma(mm, pgn)) != NULL &&
+      vma->vm_shm != NULL)
+  { /* First touch of a shared memory page */
+    if (pg_shm_fault(caller, pgn) == -1)
+      return -1;
+    faulted = 1;
+  }
+  else if (!PAGING_PAGE_PRESENT(pte))
+  { /* First touch, share the zero frame until the page is written */
+    addr_t zerofpn;
+
+    /* Only pages of the vm areas can be faulted in */
+    if ((vma = pg_get_vma(mm, pgn)) == NULL)
+      return -1;
+
+#if defined(MM64) && defined(MM_HUGEPAGE)
+    /* A whole untouched PMD inside the area takes one huge run */
+    if (pg_huge_fault(caller, vma, pgn) == 0 && pte_lookup(caller, pgn, &hpte) == 1)
+    {
+      *retpte = hpte;
+      tlb_fill_huge(mm, caller->pid, pgn, hpte, PAGING64_HUGE_ORDER);
+      return 0;
+    }
+#endif
+
+    if (pg_getzero(caller, &zerofpn) == -1)
+      return -1;
+
+    pte_set_fpn(caller, pgn, zerofpn);
+    pte_set_rdonly(caller, pgn);
+    faulted = 1;
+
+#ifdef MM_FAULT_AROUND
+    pg_fault_around(caller, pgn, zerofpn);
+#endif
+  }
+  else if (pte & PAGING_PTE_SWAPPED_MASK)
+  { /* Page is not online, make it actively living */
+    addr_t tgtfpn;
+
+    /* Initialize the target frame storing our variable */
+    if (pg_getframe(caller, &tgtfpn) == -1)
+      return -1;
+
+#ifdef MM_SWAP_READAHEAD
+    /* Before the page is mapped so making room can never evict it */
+    pg_readahead(caller, pgn);
+#endif
+
+    pg_swapin(caller, pgn, pte, tgtfpn);
+    faulted = 1;
+  }
+
+  pte = pte_get_entry(caller, pgn);
+
+  /* Only cache translations of pages living in RAM. Loading one marks
+   * the page accessed, except for the faulting access itself so a page
+   * touched once does not look referenced to the replacement policy */
+  if (PAGING_PAGE_PRESENT(pte) && !(pte & PAGING_PTE_SWAPPED_MASK))
+  {
+    if (!faulted && pte_set_bits(caller, pgn, PAGING_PTE_ACCESSED_MASK) == 0)
+      SETBIT(pte, PAGING_PTE_ACCESSED_MASK);
+
+#ifdef MM_SWAP_READAHEAD
+    /* First use of a page brought in ahead of time */
+    struct pgn_t *desc = pgn_desc(caller->krnl->mram, PAGING_FPN(pte));
+
+    if (!faulted && desc != NULL && desc->pg_ra)
+    {
+      desc->pg_ra = 0;
+      mm->ra.hits++;
+    }
+#endif
+    tlb_fill(mm, caller->pid, pgn, pte);
+  }
+
+  *retpte = pte;
+
+  return 0;
+}
+
+/*pg_getpage - get the page in ram
+ *@mm: memory region
+ *@pagenum: PGN
+ *@framenum: return FPN
+ *@caller: caller
+ *
+ */
+int pg_getpage(struct mm_struct *mm, addr_t pgn, addr_t *fpn, struct pcb_t *caller)
+{
+  addr_t pte;
+
+  if (__pg_getpage(mm, pgn, &pte, caller) != 0)
+    return -1;
+
+  *fpn = PAGING_FPN(pte);
+  return 0;
+}
+
+/*pg_wrfault - give a read-only page its private frame before a write
+ *@mm: memory region
+ *@pagenum: PGN
+ *@pte: current PTE of the page, updated to the private mapping
+ *@caller: caller
+ *
+ * The last mapper of a frame shared by fork takes the frame over, any
+ * other mapper copies it.
+ */
+static int pg_wrfault(struct mm_struct *mm, addr_t pgn, addr_t *pte, struct pcb_t *caller)
+{
+  struct memphy_struct *mram = caller->krnl->mram;
+  addr_t oldfpn = PAGING_FPN(*pte);
+  addr_t newfpn;
+  struct pgn_t *desc = NULL;
+  struct mm_struct *owner = NULL;
+
+  if (oldfpn != mram->zerofpn)
+  {
+    desc = pgn_desc(mram, oldfpn);
+    if (desc->pg_mapcount <= 1)
+    {
+      desc->pg_mapcount = 0;
+      pte_clr_bits(caller, pgn, PAGING_PTE_RDONLY_MASK);
+      enlist_pgn_node(caller, pgn, oldfpn);
+
+      *pte = pte_get_entry(caller, pgn);
+      return 0;
+    }
+
+    /* Making room must not evict the frame being copied */
+    if (desc->pg_next != NULL)
+      owner = desc->pg_mm;
+    delist_pgn_node(caller, oldfpn);
+  }
+
+  if (pg_getframe(caller, &newfpn) == -1)
+  {
+    pg_enlist_mm(caller, owner, pgn, oldfpn);
+    return -1;
+  }
+
+  /* Private copy of the shared frame */
+  __swap_cp_page(mram, oldfpn, mram, newfpn);
+
+  /* The new mapping is writable */
+  pte_set_fpn(caller, pgn, newfpn);
+
+  enlist_pgn_node(caller, pgn, newfpn);
+
+  /* A mapper left keeps tracking the shared frame */
+  if (desc != NULL)
+  {
+    desc->pg_mapcount--;
+    if (owner == caller->krnl->mm)
+      pg_handoff(caller, pgn, oldfpn);
+    else
+      pg_enlist_mm(caller, owner, pgn, oldfpn);
+  }
+
+  *pte = pte_get_entry(caller, pgn);
+  return 0;
+}
+
+/*pg_getval - read value at given offset
+ *@mm: memory region
+ *@addr: virtual address to acess
+ *@value: value
+ *
+ */
+int pg_getval(struct mm_struct *mm, addr_t addr, BYTE *data, struct pcb_t *caller)
+{
+  addr_t pgn = PAGING_PGN(addr);
+  int off = PAGING_OFFST(addr);
+  addr_t fpn;
+  struct sc_regs regs;
+
+  if (pg_getpage(mm, pgn, &fpn, caller) != 0)
+    return -1; /* invalid page access */
+
+  addr_t phyaddr = fpn * PAGING_PAGESZ + off;
+
+  /* MEMPHY READ
+   * SYSCALL 17 sys_memmap with SYSMEM_IO_READ
+   */
+  regs.a1 = SYSMEM_IO_READ;
+  regs.a2 = phyaddr;
+  syscall(caller->krnl, caller->pid, 17, &regs);
+
+  *data = (BYTE)regs.a3;
+
+  return 0;
+}
+
+/*pg_setval - write value to given offset
+ *@mm: memory region
+ *@addr: virtual address to acess
+ *@value: value
+ *
+ */
+int pg_setval(struct mm_struct *mm, addr_t addr, BYTE value, struct pcb_t *caller)
+{
+  addr_t pgn = PAGING_PGN(addr);
+  int off = PAGING_OFFST(addr);
+  addr_t fpn, pte;
+  struct sc_regs regs;
+
+  /* Get the page to MEMRAM, swap from MEMSWAP if needed */
+  if (__pg_getpage(mm, pgn, &pte, caller) != 0)
+    return -1; /* invalid page access */
+
+  /* First write to a shared read-only frame */
+  if ((pte & PAGING_PTE_RDONLY_MASK) && pg_wrfault(mm, pgn, &pte, caller) != 0)
+    return -1;
+
+  /* First write since the page came in, the TLB keeps the dirty copy */
+  if (!(pte & PAGING_PTE_DIRTY_MASK) &&
+      pte_set_bits(caller, pgn, PAGING_PTE_DIRTY_MASK) == 0)
+  {
+    SETBIT(pte, PAGING_PTE_DIRTY_MASK);
+    tlb_fill(mm, caller->pid, pgn, pte);
+  }
+
+  fpn = PAGING_FPN(pte);
+
+  addr_t phyaddr = fpn * PAGING_PAGESZ + off;
+
+  /* MEMPHY WRITE with SYSMEM_IO_WRITE
+   * SYSCALL 17 sys_memmap
+   */
+  regs.a1 = SYSMEM_IO_WRITE;
+  regs.a2 = phyaddr;
+  regs.a3 = value;
+  syscall(caller->krnl, caller->pid, 17, &regs);
+
+  return 0;
+}
+
+/*__read - read value in region memory
+ *@caller: caller
+ *@vmaid: ID vm area to alloc memory region
+ *@offset: offset to acess in memory region
+ *@rgid: memory region ID (used to identify variable in symbole table)
+ *@size: allocated size
+ *
+ */
+int __read(struct pcb_t *caller, int vmaid, int rgid, addr_t offset, BYTE *data)
+{
+  /* A read may fault pages in and walks update the mm caches */
+  pthread_mutex_lock(&mmvm_lock);
+  struct vm_rg_struct *currg = get_symrg_byid(caller->krnl->mm, rgid);
+
+//  struct vm_area_struct *cur_vma = get_vma_by_num(caller->krnl->mm, vmaid);
+
+  /* TODO Invalid memory identify */
+  if (currg == NULL)
+  {
+    pthread_mutex_unlock(&mmvm_lock);
+    return -1;
+  }
+
+  pg_getval(caller->krnl->mm, currg->rg_start + offset, data, caller);
+
+  pthread_mutex_unlock(&mmvm_lock);
+  return 0;
+}
+
+/*libread - PAGING-based read a region memory */
+int libread(
+    struct pcb_t *proc, // Process executing the instruction
+    uint32_t source,    // Index of source register
+    addr_t offset,    // Source address = [source] + [offset]
+    uint32_t* destination)
+{
+  BYTE data;
+  int val = __read(proc, 0, source, offset, &data);
+  if (val == -1)
+  {
+    return -1;
+  }
+
+  *destination = data;
+#ifdef IODUMP
+  printf("libread:%d region=%u offset=" FORMAT_ADDR " value=%d\n",
+         __LINE__, source, offset, data);
+#ifdef PAGETBL_DUMP
+  print_pgtbl(proc, 0, -1); // print max TBL
+#endif
+#endif
+
+  return val;
+}
+
+/*__write - write a region memory
+ *@caller: caller
+ *@vmaid: ID vm area to alloc memory region
+ *@offset: offset to acess in memory region
+ *@rgid: memory region ID (used to identify variable in symbole table)
+ *@size: allocated size
+ *
+ */
+int __write(struct pcb_t *caller, int vmaid, int rgid, addr_t offset, BYTE value)
+{
+  pthread_mutex_lock(&mmvm_lock);
+  struct vm_rg_struct *currg = get_symrg_byid(caller->krnl->mm, rgid);
+
+  struct vm_area_struct *cur_vma = get_vma_by_num(caller->krnl->mm, vmaid);
+
+  if (currg == NULL || cur_vma == NULL) /* Invalid memory identify */
+  {
+    pthread_mutex_unlock(&mmvm_lock);
+    return -1;
+  }
+
+  pg_setval(caller->krnl->mm, currg->rg_start + offset, value, caller);
+
+  pthread_mutex_unlock(&mmvm_lock);
+  return 0;
+}
+
+/*libwrite - PAGING-based write a region memory */
+int libwrite(
+    struct pcb_t *proc,   // Process executing the instruction
+    BYTE data,            // Data to be wrttien into memory
+    uint32_t destination, // Index of destination register
+    addr_t offset)
+{
+  int val = __write(proc, 0, destination, offset, data);
+  if (val == -1)
+  {
+    return -1;
+  }
+#ifdef IODUMP
+#ifdef PAGETBL_DUMP
+  printf("libwrite:%d\n", __LINE__);
+  print_pgtbl(proc, 0, -1); // print max TBL
+#endif
+  MEMPHY_dump(proc->krnl->mram);
+#endif
+
+  return val;
+}
+
+/*pg_swap_release - drop the swap copy of a swapped page
+ *@krnl: kernel
+ *@pte: swapped PTE
+ *
+ */
+static void pg_swap_release(struct krnl_t *krnl, addr_t pte)
+{
+  if (PAGING_SWPTYP(pte) == PAGING_SWP_ZSWAP)
+    zswap_free(&krnl->swap->zpool, PAGING_SWP(pte));
+  else
+    swap_free(krnl->swap, PAGING_SWPTYP(pte), PAGING_SWP(pte));
+}
+
+/*pg_put_frame - release the frame of a page nobody maps any more
+ *@caller: caller
+ *@fpn: frame
+ *
+ */
+static void pg_put_frame(struct pcb_t *caller, addr_t fpn)
+{
+  struct krnl_t *krnl = caller->krnl;
+  struct pgn_t *desc = pgn_desc(krnl->mram, fpn);
+
+  delist_pgn_node(caller, fpn);
+
+  /* Drop the swap cache slot with the frame */
+  if (desc->pg_swcache)
+    swap_free(krnl->swap, desc->pg_swptyp, desc->pg_swpoff);
+  desc->pg_swcache = 0;
+  desc->pg_ra = 0;
+  desc->pg_mapcount = 0;
+  MEMPHY_put_freefp(krnl->mram, fpn);
+}
+
+/*pg_shm_map - add an attachment to its segment and map the segment pages
+ *@caller: caller, owner of @vma
+ *@vma: vm area of the attachment
+ *
+ * The pages are mapped the way another attachment maps them, resident
+ * ones to their frame and swapped ones to their swap copy.
+ */
+static int pg_shm_map(struct pcb_t *caller, struct vm_area_struct *vma)
+{
+  struct shm_segment *seg = vma->vm_shm;
+  struct shm_attach *at = malloc(sizeof(struct shm_attach));
+  struct krnl_t krnl = *caller->krnl;
+  struct pcb_t kthread;
+  addr_t pgn = vma->vm_start / PAGING_PAGESZ;
+  addr_t i, pte;
+
+  if (at == NULL)
+    return -1;
+
+  if (seg->attach != NULL)
+  {
+    krnl.mm = seg->attach->mm;
+    kthread.krnl = &krnl;
+    kthread.pid = 0;
+
+    for (i = 0; i < seg->npages; i++)
+    {
+      pte = pte_get_entry(&kthread, seg->attach->pgn + i);
+      if (PAGING_PAGE_PRESENT(pte))
+        pte_set_entry(caller, pgn + i,
+                      pte & ~(PAGING_PTE_ACCESSED_MASK | PAGING_PTE_DIRTY_MASK));
+    }
+  }
+
+  at->mm = caller->krnl->mm;
+  at->pgn = pgn;
+  at->next = seg->attach;
+  seg->attach = at;
+  seg->nattch++;
+
+  return 0;
+}
+
+/*pg_shm_unmap - remove an attachment from its segment
+ *@caller: caller, owner of @vma
+ *@vma: vm area of the attachment
+ *
+ * The frames and swap copies go with the last attachment, until then
+ * another attachment takes over the tracking of the resident pages.
+ */
+static void pg_shm_unmap(struct pcb_t *caller, struct vm_area_struct *vma)
+{
+  struct shm_segment *seg = vma->vm_shm, **pseg;
+  struct shm_attach *at, **pat;
+  struct pgn_t *desc;
+  addr_t pgn = vma->vm_start / PAGING_PAGESZ;
+  addr_t endpgn = vma->vm_end / PAGING_PAGESZ;
+  addr_t pte, fpn, i;
+  int last = (seg->nattch == 1);
+
+  for (i = pgn; i < endpgn; i++)
+  {
+    pte = pte_get_entry(caller, i);
+    if (!PAGING_PAGE_PRESENT(pte))
+      continue;
+
+    if (pte & PAGING_PTE_SWAPPED_MASK)
+    {
+      if (last)
+        pg_swap_release(caller->krnl, pte);
+    }
+    else if (last)
+      pg_put_frame(caller, PAGING_FPN(pte));
+    else
+    {
+      fpn = PAGING_FPN(pte);
+      desc = pgn_desc(caller->krnl->mram, fpn);
+
+      /* The dirty bit leaves with the PTE, so the swap cache copy can
+       * no longer be trusted */
+      if ((pte & PAGING_PTE_DIRTY_MASK) && desc->pg_swcache)
+      {
+        swap_free(caller->krnl->swap, desc->pg_swptyp, desc->pg_swpoff);
+        desc->pg_swcache = 0;
+      }
+
+      if (desc->pg_next != NULL && desc->pg_mm == caller->krnl->mm && desc->pgn == i)
+      {
+        delist_pgn_node(caller, fpn);
+        pg_handoff(caller, i, fpn);
+      }
+    }
+
+    pte_set_entry(caller, i, 0);
+  }
+
+  for (pat = &seg->attach; (at = *pat) != NULL; pat = &at->next)
+  {
+    if (at->mm == caller->krnl->mm && at->pgn == pgn)
+    {
+      *pat = at->next;
+      free(at);
+      break;
+    }
+  }
+
+  if (--seg->nattch > 0)
+    return;
+
+  for (pseg = &shm_list; *pseg != NULL; pseg = &(*pseg)->next)
+  {
+    if (*pseg == seg)
+    {
+      *pseg = seg->next;
+      break;
+    }
+  }
+  free(seg);
+}
+
+/*__free_pcb_memph - release the frames and swap copies of an mm
+ *@caller: caller
+ *
+ * Walks the pages of every vm area, a frame shared by fork is only
+ * released by its last mapper and a shared memory attachment is
+ * removed from its segment. Caller holds mmvm_lock.
+ */
+static void __free_pcb_memph(struct pcb_t *caller)
+{
+  struct krnl_t *krnl = caller->krnl;
+  struct memphy_struct *mram = krnl->mram;
+  struct vm_area_struct *vma;
+  struct pgn_t *desc;
+  addr_t pgn, endpgn, pte, fpn;
+
+  for (vma = krnl->mm->mmap; vma != NULL; vma = vma->vm_next)
+  {
+    if (vma->vm_shm != NULL)
+    {
+      pg_shm_unmap(caller, vma);
+      vma->vm_shm = NULL;
+      continue;
+    }
+
+    endpgn = DIV_ROUND_UP(vma->vm_end, PAGING_PAGESZ);
+    for (pgn = vma->vm_start / PAGING_PAGESZ; pgn < endpgn; pgn++)
+    {
+#ifdef MM64
+      /* A huge run goes back whole, then skip the rest of it */
+      if (pte_lookup(caller, pgn, &pte) == 1)
+      {
+        MEMPHY_free_contig(mram, PAGING_FPN(pte) - (pgn & (PAGING64_HUGE_PGNUM - 1)),
+                           PAGING64_HUGE_ORDER);
+        pgn |= PAGING64_HUGE_PGNUM - 1;
+        continue;
+      }
+#endif
+      pte = pte_get_entry(caller, pgn);
+      if (!PAGING_PAGE_PRESENT(pte))
+        continue;
+
+      if (pte & PAGING_PTE_SWAPPED_MASK)
+        pg_swap_release(krnl, pte);
+      else if ((fpn = PAGING_FPN(pte)) != mram->zerofpn)
+      {
+        desc = pgn_desc(mram, fpn);
+        if (desc->pg_mapcount > 1)
+        {
+          /* Still shared, a mapper left keeps tracking it */
+          desc->pg_mapcount--;
+          if (desc->pg_next != NULL && desc->pg_mm == krnl->mm)
+          {
+            delist_pgn_node(caller, fpn);
+            pg_handoff(caller, pgn, fpn);
+          }
+        }
+        else
+          pg_put_frame(caller, fpn);
+      }
+
+      pte_set_entry(caller, pgn, 0);
+    }
+  }
+}
+
+/*free_pcb_memphy - collect all memphy of pcb
+ *@caller: caller
+ *
+ */
+int free_pcb_memph(struct pcb_t *caller)
+{
+  pthread_mutex_lock(&mmvm_lock);
+  __free_pcb_memph(caller);
+  pthread_mutex_unlock(&mmvm_lock);
+
+  return 0;
+}
+
+/*pg_swap_dup - give a swapped page a swap copy of its own
+ *@krnl: kernel
+ *@pte: swapped PTE of the page
+ *@swptyp: return swap type of the copy
+ *@swpoff: return swap offset of the copy
+ *
+ */
+static int pg_swap_dup(struct krnl_t *krnl, addr_t pte, int *swptyp, addr_t *swpoff)
+{
+  BYTE page[PAGING_PAGESZ];
+  int typ = PAGING_SWPTYP(pte);
+  addr_t off = PAGING_SWP(pte);
+
+  if (typ == PAGING_SWP_ZSWAP)
+  {
+    if (zswap_load(&krnl->swap->zpool, off, page) != 0)
+      return -1;
+  }
+  else if (MEMPHY_read_block(swap_dev(krnl->swap, typ), off * PAGING_PAGESZ,
+                             page, PAGING_PAGESZ) < 0)
+    return -1;
+
+  return pg_swap_write(krnl, page, swptyp, swpoff);
+}
+
+#ifdef MM64
+/*pg_huge_dup - give the child its own copy of a huge run
+ *@caller: parent
+ *@child: child
+ *@pgn: page of the huge mapping
+ *@fpn: frame of that page
+ *
+ */
+static int pg_huge_dup(struct pcb_t *caller, struct pcb_t *child, addr_t pgn, addr_t fpn)
+{
+  struct memphy_struct *mram = caller->krnl->mram;
+  addr_t base = pgn & ~((addr_t)PAGING64_HUGE_PGNUM - 1);
+  addr_t src = fpn - (pgn - base);
+  addr_t dst, i;
+
+  if (vmap_huge_page(child, base) != 0 || pte_lookup(child, base, &dst) != 1)
+    return -1;
+
+  dst = PAGING_FPN(dst);
+  for (i = 0; i < PAGING64_HUGE_PGNUM; i++)
+    __swap_cp_page(mram, src + i, mram, dst + i);
+
+  return 0;
+}
+#endif
+
+/*copy_mm - clone the address space of a process for fork
+ *@caller: parent
+ *@child: child, child->krnl->mm is the mm to fill in
+ *
+ * The vm areas, the symbol table and the page table are copied. Resident
+ * pages are not, both processes map the frame read-only and the first
+ * write in pg_setval() makes a private copy. Swapped pages and huge runs
+ * are copied right away. Shared memory attachments map the same segment.
+ * On failure the child mm is emptied and taken off the mm list.
+ */
+int copy_mm(struct pcb_t *caller, struct pcb_t *child)
+{
+  struct memphy_struct *mram = caller->krnl->mram;
+  struct mm_struct *pmm = caller->krnl->mm;
+  struct mm_struct *mm = child->krnl->mm;
+  struct vm_area_struct *vma, *nvma, **vmtail;
+  struct vm_rg_struct *rg, **rgtail;
+  struct pgn_t *desc;
+  addr_t pgn, endpgn, pte, fpn, swpoff;
+  int swptyp;
+
+  if (init_mm(mm, child) != 0)
+    return -1;
+
+  pthread_mutex_lock(&mmvm_lock);
+
+  /* The parent's vm areas replace the empty one of init_mm */
+  free(mm->mmap->vm_freerg_list);
+  free(mm->mmap);
+  vmtail = &mm->mmap;
+  for (vma = pmm->mmap; vma != NULL; vma = vma->vm_next)
+  {
+    nvma = malloc(sizeof(struct vm_area_struct));
+    *nvma = *vma;
+    nvma->vm_mm = mm;
+    nvma->vm_next = NULL;
+
+    rgtail = &nvma->vm_freerg_list;
+    for (rg = vma->vm_freerg_list; rg != NULL; rg = rg->rg_next)
+    {
+      *rgtail = init_vm_rg(rg->rg_start, rg->rg_end);
+      rgtail = &(*rgtail)->rg_next;
+    }
+
+    *vmtail = nvma;
+    vmtail = &nvma->vm_next;
+
+    /* A shared memory attachment is inherited, not copied */
+    if (nvma->vm_shm != NULL && pg_shm_map(child, nvma) != 0)
+    {
+      nvma->vm_shm = NULL;
+      goto fail;
+    }
+  }
+
+  memcpy(mm->symrgtbl, pmm->symrgtbl, sizeof(mm->symrgtbl));
+  mm->ra.win = pmm->ra.win;
+
+  for (vma = pmm->mmap; vma != NULL; vma = vma->vm_next)
+  {
+    if (vma->vm_shm != NULL)
+      continue;
+
+    endpgn = DIV_ROUND_UP(vma->vm_end, PAGING_PAGESZ);
+    for (pgn = vma->vm_start / PAGING_PAGESZ; pgn < endpgn; pgn++)
+    {
+#ifdef MM64
+      if (pte_lookup(caller, pgn, &pte) == 1)
+      {
+        if (pg_huge_dup(caller, child, pgn, PAGING_FPN(pte)) != 0)
+          goto fail;
+        pgn |= PAGING64_HUGE_PGNUM - 1;
+        continue;
+      }
+#endif
+      pte = pte_get_entry(caller, pgn);
+      if (!PAGING_PAGE_PRESENT(pte))
+        continue;
+
+      if (pte & PAGING_PTE_SWAPPED_MASK)
+      {
+        if (pg_swap_dup(caller->krnl, pte, &swptyp, &swpoff) != 0)
+          goto fail;
+        pte_set_swap(child, pgn, swptyp, swpoff);
+        continue;
+      }
+
+      /* Share the frame write-protected, the zero frame already is.
+       * The mm tracking it for replacement keeps doing so */
+      fpn = PAGING_FPN(pte);
+      if (fpn != mram->zerofpn)
+      {
+        desc = pgn_desc(mram, fpn);
+        desc->pg_mapcount = desc->pg_mapcount ? desc->pg_mapcount + 1 : 2;
+
+        pte_set_rdonly(caller, pgn);
+        SETBIT(pte, PAGING_PTE_RDONLY_MASK);
+      }
+      pte_set_entry(child, pgn, pte);
+    }
+  }
+
+  pthread_mutex_unlock(&mmvm_lock);
+  return 0;
+
+fail:
+  /* Out of swap or of contiguous RAM, undo the child's share and what
+   * init_mm built, the caller frees the mm struct */
+  __free_pcb_memph(child);
+  mm_unlink(mm);
+  free_mm(mm);
+  pthread_mutex_unlock(&mmvm_lock);
+  return -1;
+}
+
+/*__shmget - get the shared memory segment of a key
+ *@key: segment key
+ *@size: segment size, a new segment is created with it
+ *
+ * Returns the segment id, which is the key, -1 when an existing segment
+ * is smaller than @size.
+ */
+int __shmget(int key, addr_t size)
+{
+  struct shm_segment *seg;
+
+  if (key < 0)
+    return -1;
+
+  pthread_mutex_lock(&mmvm_lock);
+  for (seg = shm_list; seg != NULL; seg = seg->next)
+    if (seg->key == key)
+      break;
+
+  if (seg == NULL && size > 0 && (seg = malloc(sizeof(struct shm_segment))) != NULL)
+  {
+    seg->key = key;
+    seg->npages = DIV_ROUND_UP(size, PAGING_PAGESZ);
+    seg->nattch = 0;
+    seg->attach = NULL;
+    seg->next = shm_list;
+    shm_list = seg;
+  }
+
+  if (seg == NULL || DIV_ROUND_UP(size, PAGING_PAGESZ) > seg->npages)
+  {
+    pthread_mutex_unlock(&mmvm_lock);
+    return -1;
+  }
+
+  pthread_mutex_unlock(&mmvm_lock);
+  return key;
+}
+
+/*__shmat - attach a shared memory segment
+ *@caller: caller
+ *@key: segment id
+ *@rgid: memory region ID the segment is reached through
+ *
+ * The segment gets a vm area of its own above PAGING_SHM_BASE, the
+ * region covers all of it. A region in use, allocated or attached, is
+ * refused, free or detach it first.
+ */
+int __shmat(struct pcb_t *caller, int key, int rgid)
+{
+  struct mm_struct *mm = caller->krnl->mm;
+  struct vm_rg_struct *rgnode = get_symrg_byid(mm, rgid);
+  struct vm_area_struct *vma, *last = NULL, *nvma;
+  struct shm_segment *seg;
+  addr_t start = PAGING_SHM_BASE;
+
+  if (rgnode == NULL)
+    return -1;
+
+  pthread_mutex_lock(&mmvm_lock);
+
+  /* The region still names an allocation or an attachment */
+  if (rgnode->rg_start != 0 || rgnode->rg_end != 0)
+  {
+    pthread_mutex_unlock(&mmvm_lock);
+    return -1;
+  }
+
+  for (seg = shm_list; seg != NULL; seg = seg->next)
+    if (seg->key == key)
+      break;
+
+  nvma = malloc(sizeof(struct vm_area_struct));
+  if (seg == NULL || nvma == NULL)
+  {
+    free(nvma);
+    pthread_mutex_unlock(&mmvm_lock);
+    return -1;
+  }
+
+  /* Above every area, the vm area ids stay in list order */
+  for (vma = mm->mmap; vma != NULL; vma = vma->vm_next)
+  {
+    if (vma->vm_end > start)
+      start = vma->vm_end;
+    last = vma;
+  }
+
+  nvma->vm_id = last->vm_id + 1;
+  nvma->vm_start = start;
+  nvma->vm_end = start + seg->npages * PAGING_PAGESZ;
+  nvma->sbrk = nvma->vm_end;
+  nvma->vm_mm = mm;
+  nvma->vm_shm = seg;
+  nvma->vm_freerg_list = NULL;
+  nvma->vm_next = NULL;
+
+  if (pg_shm_map(caller, nvma) != 0)
+  {
+    free(nvma);
+    pthread_mutex_unlock(&mmvm_lock);
+    return -1;
+  }
+  last->vm_next = nvma;
+
+  rgnode->rg_start = nvma->vm_start;
+  rgnode->rg_end = nvma->vm_end;
+
+  pthread_mutex_unlock(&mmvm_lock);
+  return 0;
+}
+
+/*__shmdt - detach a shared memory segment
+ *@caller: caller
+ *@rgid: memory region ID the segment was attached to
+ *
+ */
+int __shmdt(struct pcb_t *caller, int rgid)
+{
+  struct mm_struct *mm = caller->krnl->mm;
+  struct vm_rg_struct *rgnode = get_symrg_byid(mm, rgid);
+  struct vm_area_struct *vma, **pvma;
+
+  if (rgnode == NULL)
+    return -1;
+
+  pthread_mutex_lock(&mmvm_lock);
+  for (pvma = &mm->mmap; (vma = *pvma) != NULL; pvma = &vma->vm_next)
+    if (vma->vm_shm != NULL && vma->vm_start == rgnode->rg_start)
+      break;
+
+  if (vma == NULL)
+  {
+    pthread_mutex_unlock(&mmvm_lock);
+    return -1;
+  }
+
+  pg_shm_unmap(caller, vma);
+  *pvma = vma->vm_next;
+  free(vma);
+
+  rgnode->rg_start = rgnode->rg_end = 0;
+
+  pthread_mutex_unlock(&mmvm_lock);
+  return 0;
+}
+
+/*find_victim_page - find victim page
+ *@caller: caller
+ *@pgn: return page number
+ *
+ * The replacement list is circular with the newest page at its head,
+ * the oldest page right behind it is where the CLOCK hand points.
+ */
+int find_victim_page(struct pcb_t *caller, addr_t *retpgn)
+{
+  struct mm_struct *mm = caller->krnl->mm;
+  struct pgn_t *pg = mm->fifo_pgn;
+
+#if MM_REPL_POLICY == PAGING_REPL_ARC
+  /* T1 alone may be empty, CAR runs both clocks */
+  (void)pg;
+  if (arc_victim(caller, retpgn) != 0)
+    return -1;
+#else
+  if (!pg)
+    return -1; 
+
+#if MM_REPL_POLICY == PAGING_REPL_CLOCK
+  /* Second chance, an accessed page loses its bit and goes back to the
+   * head; a full turn clears every bit so the loop ends */
+  while (pte_get_entry(caller, mm->fifo_pgn->pg_prev->pgn) & PAGING_PTE_ACCESSED_MASK)
+  {
+    pg = mm->fifo_pgn->pg_prev;
+    pte_clr_bits(caller, pg->pgn, PAGING_PTE_ACCESSED_MASK);
+    pgn_list_del(&mm->fifo_pgn, pg);
+    pgn_list_add(&mm->fifo_pgn, pg);
+  }
+  pg = mm->fifo_pgn->pg_prev;
+#elif MM_REPL_POLICY == PAGING_REPL_ECLOCK
+  /* Enhanced CLOCK, the hand looks for (!accessed, !dirty) first, then
+   * for (!accessed, dirty) clearing accessed bits on the way; four
+   * passes always find a victim */
+  struct pgn_t *hand = pg->pg_prev;
+  struct pgn_t *vic = NULL;
+  int pass;
+
+  for (pass = 0; pass < 4 && vic == NULL; pass++)
+  {
+    pg = hand;
+    do
+    {
+      addr_t pte = pte_get_entry(caller, pg->pgn);
+
+      if (!(pte & PAGING_PTE_ACCESSED_MASK) &&
+          !(pte & PAGING_PTE_DIRTY_MASK) == !(pass & 1))
+      {
+        vic = pg;
+        break;
+      }
+
+      if (pass & 1)
+        pte_clr_bits(caller, pg->pgn, PAGING_PTE_ACCESSED_MASK);
+
+      pg = pg->pg_prev;
+    } while (pg != hand);
+  }
+  pg = vic;
+#else
+  /* FIFO, the oldest page sits right behind the head */
+  pg = pg->pg_prev;
+#endif
+
+  *retpgn = pg->pgn;
+  pgn_list_del(&mm->fifo_pgn, pg);
+#endif
+
+#ifdef IODUMP
+  printf("\tPID %d evicts page " FORMAT_ADDR "\n", caller->pid, *retpgn);
+#endif
 
   return 0;
 }
@@ -5,6 +5,7 @@
 #include <string.h>
 
 static uint32_t avail_pid = 1;
+static pthread_mutex_t pid_lock = PTHREAD_MUTEX_INITIALIZER;
 
 #define OPT_CALC	"calc"
 #define OPT_ALLOC	"alloc"
@@ -32,11 +33,21 @@ static enum ins_opcode_t get_opcode(char * opt) {
 	}
 }
 
+/* Hand out the next PID, forked processes take theirs from CPU threads */
+uint32_t alloc_pid(void) {
+	uint32_t pid;
+
+	pthread_mutex_lock(&pid_lock);
+	pid = avail_pid++;
+	pthread_mutex_unlock(&pid_lock);
+
+	return pid;
+}
+
 struct pcb_t * load(const char * path) {
 	/* Create new PCB for the new process */
 	struct pcb_t * proc = (struct pcb_t * )malloc(sizeof(struct pcb_t));
-	proc->pid = avail_pid;
-	avail_pid++;
+	proc->pid = alloc_pid();
 	proc->page_table =
 		(struct page_table_t*)malloc(sizeof(struct page_table_t));
 	memset(proc->page_table, 0, sizeof(struct page_table_t));
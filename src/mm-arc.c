@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+#ifdef MM_PAGING
+/*
+ * PAGING based Memory Management
+ * Adaptive page replacement module mm/mm-arc.c
+ *
+ * CAR (Clock with Adaptive Replacement): the resident pages sit on two
+ * clocks, T1 for pages seen once and T2 for pages seen again, and the
+ * page numbers of recent victims are kept on the ghost lists B1 and B2.
+ * A fault on a B1 ghost grows the target size p of T1, a fault on a B2
+ * ghost shrinks it, so a long scan only churns T1 and the hot set in
+ * T2 survives.
+ */
+
+#include "mm.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ *  arc_cap - cache size c, the number of RAM frames
+ */
+static addr_t arc_cap(struct pcb_t *caller)
+{
+   return caller->krnl->mram->maxsz / PAGING_PAGESZ;
+}
+
+/*
+ *  arc_init - allocate the ghost hash on first use
+ */
+static int arc_init(struct pgn_arc *arc, addr_t cap)
+{
+   addr_t sz = 64;
+
+   if (arc->hash != NULL)
+      return 0;
+
+   while (sz < cap && sz < PAGING_ARC_HASH_MAX)
+      sz <<= 1;
+
+   arc->hash = calloc(sz, sizeof(struct pgn_ghost *));
+   if (arc->hash == NULL)
+      return -1;
+
+   arc->hashsz = sz;
+   return 0;
+}
+
+/*
+ *  arc_ghost_find - look up the ghost of a page
+ */
+static struct pgn_ghost *arc_ghost_find(struct pgn_arc *arc, addr_t pgn)
+{
+   struct pgn_ghost *gh = arc->hash[pgn & (arc->hashsz - 1)];
+
+   while (gh != NULL && gh->pgn != pgn)
+      gh = gh->gh_hnext;
+
+   return gh;
+}
+
+/*
+ *  arc_ghost_del - forget a ghost, its entry goes back to the pool
+ */
+static void arc_ghost_del(struct pgn_arc *arc, struct pgn_ghost *gh)
+{
+   struct pgn_ghost **list = (gh->gh_list == 1) ? &arc->b1 : &arc->b2;
+   struct pgn_ghost **pp = &arc->hash[gh->pgn & (arc->hashsz - 1)];
+
+   while (*pp != gh)
+      pp = &(*pp)->gh_hnext;
+   *pp = gh->gh_hnext;
+
+   if (gh->gh_next == gh)
+      *list = NULL;
+   else
+   {
+      gh->gh_prev->gh_next = gh->gh_next;
+      gh->gh_next->gh_prev = gh->gh_prev;
+      if (*list == gh)
+         *list = gh->gh_next;
+   }
+
+   if (gh->gh_list == 1)
+      arc->nb1--;
+   else
+      arc->nb2--;
+
+   gh->gh_hnext = arc->pool;
+   arc->pool = gh;
+}
+
+/*
+ *  arc_ghost_add - remember an evicted page as the newest ghost of a list
+ *  @list: 1 for B1, 2 for B2
+ */
+static void arc_ghost_add(struct pgn_arc *arc, addr_t pgn, int list)
+{
+   struct pgn_ghost **head = (list == 1) ? &arc->b1 : &arc->b2;
+   struct pgn_ghost **bucket = &arc->hash[pgn & (arc->hashsz - 1)];
+   struct pgn_ghost *gh = arc->pool;
+
+   if (gh != NULL)
+      arc->pool = gh->gh_hnext;
+   else if ((gh = malloc(sizeof(struct pgn_ghost))) == NULL)
+      return;  /* the ghost is only a hint */
+
+   gh->pgn = pgn;
+   gh->gh_list = list;
+
+   if (*head == NULL)
+   {
+      gh->gh_next = gh;
+      gh->gh_prev = gh;
+   }
+   else
+   {
+      gh->gh_next = *head;
+      gh->gh_prev = (*head)->gh_prev;
+      (*head)->gh_prev->gh_next = gh;
+      (*head)->gh_prev = gh;
+   }
+   *head = gh;
+
+   gh->gh_hnext = *bucket;
+   *bucket = gh;
+
+   if (list == 1)
+      arc->nb1++;
+   else
+      arc->nb2++;
+}
+
+/*
+ *  arc_enlist - make a page resident under CAR
+ *  @caller: caller
+ *  @pnode: descriptor of the page frame, not on any list
+ *
+ *  A page remembered by a ghost list adapts p and goes to T2, a new page
+ *  goes to T1 after trimming the ghost directory to its 2c bound.
+ */
+int arc_enlist(struct pcb_t *caller, struct pgn_t *pnode)
+{
+   struct mm_struct *mm = caller->krnl->mm;
+   struct pgn_arc *arc = &mm->arc;
+   addr_t cap = arc_cap(caller);
+   struct pgn_ghost *gh;
+   addr_t delta;
+
+   if (arc_init(arc, cap) != 0)
+      return -1;
+
+   gh = arc_ghost_find(arc, pnode->pgn);
+
+   if (gh == NULL)
+   {
+      if (arc->nt1 + arc->nb1 >= cap && arc->b1 != NULL)
+         arc_ghost_del(arc, arc->b1->gh_prev);
+      else if (arc->nt1 + arc->nt2 + arc->nb1 + arc->nb2 >= 2 * cap && arc->b2 != NULL)
+         arc_ghost_del(arc, arc->b2->gh_prev);
+
+      pnode->pg_freq = 0;
+      pgn_list_add(&mm->fifo_pgn, pnode);
+      arc->nt1++;
+      return 0;
+   }
+
+   if (gh->gh_list == 1)
+   {
+      /* Recency was evicted too early, grow T1 */
+      delta = (arc->nb2 > arc->nb1) ? arc->nb2 / arc->nb1 : 1;
+      arc->p = (arc->p + delta < cap) ? arc->p + delta : cap;
+   }
+   else
+   {
+      /* Frequency was evicted too early, shrink T1 */
+      delta = (arc->nb1 > arc->nb2) ? arc->nb1 / arc->nb2 : 1;
+      arc->p = (arc->p > delta) ? arc->p - delta : 0;
+   }
+
+   arc_ghost_del(arc, gh);
+
+   pnode->pg_freq = 1;
+   pgn_list_add(&arc->t2, pnode);
+   arc->nt2++;
+
+   return 0;
+}
+
+/*
+ *  arc_delist - drop a resident page from its clock
+ *  @mm: memory region
+ *  @pnode: descriptor of the page frame
+ */
+int arc_delist(struct mm_struct *mm, struct pgn_t *pnode)
+{
+   struct pgn_arc *arc = &mm->arc;
+
+   if (pnode->pg_freq)
+   {
+      pgn_list_del(&arc->t2, pnode);
+      arc->nt2--;
+   }
+   else
+   {
+      pgn_list_del(&mm->fifo_pgn, pnode);
+      arc->nt1--;
+   }
+
+   return 0;
+}
+
+/*
+ *  arc_victim - run the CAR clocks to pick a victim page
+ *  @caller: caller
+ *  @retpgn: return page number
+ *
+ *  The T1 hand runs while T1 is above its target p, else the T2 hand.
+ *  Accessed pages lose their bit and move to the newest end of T2, the
+ *  victim is remembered on the ghost list of the clock it left.
+ */
+int arc_victim(struct pcb_t *caller, addr_t *retpgn)
+{
+   struct mm_struct *mm = caller->krnl->mm;
+   struct pgn_arc *arc = &mm->arc;
+   struct pgn_t *pg;
+
+   if (mm->fifo_pgn == NULL && arc->t2 == NULL)
+      return -1;
+
+   while (1)
+   {
+      if (mm->fifo_pgn != NULL && (arc->nt1 >= (arc->p ? arc->p : 1) || arc->t2 == NULL))
+      {
+         pg = mm->fifo_pgn->pg_prev;
+         pgn_list_del(&mm->fifo_pgn, pg);
+         arc->nt1--;
+
+         if (!(pte_get_entry(caller, pg->pgn) & PAGING_PTE_ACCESSED_MASK))
+         {
+            /* An unused readahead page tells nothing about the workload */
+            if (!pg->pg_ra)
+               arc_ghost_add(arc, pg->pgn, 1);
+            break;
+         }
+      }
+      else
+      {
+         pg = arc->t2->pg_prev;
+         pgn_list_del(&arc->t2, pg);
+         arc->nt2--;
+
+         if (!(pte_get_entry(caller, pg->pgn) & PAGING_PTE_ACCESSED_MASK))
+         {
+            arc_ghost_add(arc, pg->pgn, 2);
+            break;
+         }
+      }
+
+      /* Referenced again, second chance on the frequency clock */
+      pte_clr_bits(caller, pg->pgn, PAGING_PTE_ACCESSED_MASK);
+      pg->pg_freq = 1;
+      pgn_list_add(&arc->t2, pg);
+      arc->nt2++;
+   }
+
+   *retpgn = pg->pgn;
+
+   return 0;
+}
+
+/*
+ *  arc_release - free the ghost entries and the ghost hash of an mm
+ *  @arc: CAR state, the resident clocks must already be empty
+ */
+void arc_release(struct pgn_arc *arc)
+{
+   struct pgn_ghost *gh;
+   addr_t b;
+
+   for (b = 0; arc->hash != NULL && b < arc->hashsz; b++)
+      while ((gh = arc->hash[b]) != NULL)
+      {
+         arc->hash[b] = gh->gh_hnext;
+         free(gh);
+      }
+
+   while ((gh = arc->pool) != NULL)
+   {
+      arc->pool = gh->gh_hnext;
+      free(gh);
+   }
+
+   free(arc->hash);
+   arc->hash = NULL;
+   arc->b1 = arc->b2 = NULL;
+   arc->nb1 = arc->nb2 = 0;
+}
+
+#endif
@@ -18,27 +18,146 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* Simulated CPU the current thread runs for, -1 outside CPU threads */
+static __thread int memphy_cpu = -1;
+
+/*
+ *  MEMPHY_bind_cpu - bind the calling thread to a simulated CPU
+ *  @cpuid: CPU id, selects the per-CPU magazine of every device
+ */
+void MEMPHY_bind_cpu(int cpuid)
+{
+   memphy_cpu = cpuid;
+}
+
+/*
+ *  MEMPHY_get_cpu - simulated CPU of the calling thread, -1 if none
+ */
+int MEMPHY_get_cpu(void)
+{
+   return memphy_cpu;
+}
+
+/*
+ *  MEMPHY_get_mag - magazine of the current CPU, NULL if none
+ *  @mp: memphy struct
+ */
+static struct memphy_mag *MEMPHY_get_mag(struct memphy_struct *mp)
+{
+   if (mp->mags == NULL || memphy_cpu < 0 || memphy_cpu >= PAGING_MAX_CPU)
+      return NULL;
+
+   return &mp->mags[memphy_cpu];
+}
+
+/*
+ *  MEMPHY_init_mags - allocate the per-CPU magazines of a device
+ *  @mp: memphy struct
+ */
+static void MEMPHY_init_mags(struct memphy_struct *mp)
+{
+   int cpu;
+
+   mp->mags = calloc(PAGING_MAX_CPU, sizeof(struct memphy_mag));
+   if (mp->mags == NULL)
+      return;
+
+   for (cpu = 0; cpu < PAGING_MAX_CPU; cpu++)
+      pthread_mutex_init(&mp->mags[cpu].lock, NULL);
+}
+
+/*
+ *  MEMPHY_ptr - host address of a device address
+ *  @mp: memphy struct
+ *  @addr: address
+ *
+ *  Frame-indirected devices look the frame up in the frame table, the
+ *  others address their storage directly.
+ */
+static BYTE *MEMPHY_ptr(struct memphy_struct *mp, addr_t addr)
+{
+   if (mp->frames == NULL)
+      return mp->storage + addr;
+
+   return mp->frames[addr / PAGING_PAGESZ] + addr % PAGING_PAGESZ;
+}
+
+/*
+ *  MEMPHY_copy - move a range between a buffer and a device
+ *  @mp: memphy struct
+ *  @addr: start address
+ *  @buf: buffer
+ *  @size: number of bytes
+ *  @wr: copy to the device
+ *
+ *  A frame-indirected range is moved frame by frame.
+ */
+static void MEMPHY_copy(struct memphy_struct *mp, addr_t addr, BYTE *buf, addr_t size, int wr)
+{
+   addr_t len;
+
+   while (size > 0)
+   {
+      len = size;
+      if (mp->frames != NULL && addr % PAGING_PAGESZ + len > PAGING_PAGESZ)
+         len = PAGING_PAGESZ - addr % PAGING_PAGESZ;
+
+      if (wr)
+         memcpy(MEMPHY_ptr(mp, addr), buf, len);
+      else
+         memcpy(buf, MEMPHY_ptr(mp, addr), len);
+
+      addr += len;
+      buf += len;
+      size -= len;
+   }
+}
 
 /*
  *  MEMPHY_mv_csr - move MEMPHY cursor
  *  @mp: memphy struct
  *  @offset: offset
+ *
+ *  The cursor jumps straight to @offset, the distance it travelled is
+ *  charged to the device seek cost for the timing model.
  */
 int MEMPHY_mv_csr(struct memphy_struct *mp, addr_t offset)
 {
-   int numstep = 0;
+   if (offset >= mp->maxsz)
+      return -1;
 
-   mp->cursor = 0;
-   while (numstep < offset && numstep < mp->maxsz)
-   {
-      /* Traverse sequentially */
-      mp->cursor = (mp->cursor + 1) % mp->maxsz;
-      numstep++;
-   }
+   if (offset > mp->cursor)
+      mp->seekcost += offset - mp->cursor;
+   else
+      mp->seekcost += mp->cursor - offset;
+
+   mp->cursor = offset;
 
    return 0;
 }
 
+/*
+ *  MEMPHY_get_seekcost - accumulated seek distance of MEMPHY device
+ *  @mp: memphy struct
+ */
+uint64_t MEMPHY_get_seekcost(struct memphy_struct *mp)
+{
+   uint64_t cost;
+
+   if (mp == NULL)
+      return 0;
+
+   pthread_mutex_lock(&mp->lock);
+   cost = mp->seekcost;
+   pthread_mutex_unlock(&mp->lock);
+
+   return cost;
+}
+
 /*
  *  MEMPHY_seq_read - read MEMPHY device
  *  @mp: memphy struct
@@ -50,11 +169,18 @@ int MEMPHY_seq_read(struct memphy_struct *mp, addr_t addr, BYTE *value)
    if (mp == NULL)
       return -1;
 
-   if (!mp->rdmflg)
+   if (mp->rdmflg)
       return -1; /* Not compatible mode for sequential read */
 
-   MEMPHY_mv_csr(mp, addr);
-   *value = (BYTE)mp->storage[addr];
+   pthread_mutex_lock(&mp->lock);
+   if (MEMPHY_mv_csr(mp, addr) < 0)
+   {
+      pthread_mutex_unlock(&mp->lock);
+      return -1;
+   }
+   *value = *MEMPHY_ptr(mp, addr);
+   mp->cursor = (addr + 1) % mp->maxsz;
+   pthread_mutex_unlock(&mp->lock);
 
    return 0;
 }
@@ -71,7 +197,7 @@ int MEMPHY_read(struct memphy_struct *mp, addr_t addr, BYTE *value)
       return -1;
 
    if (mp->rdmflg)
-      *value = mp->storage[addr];
+      *value = *MEMPHY_ptr(mp, addr);
    else /* Sequential access device */
       return MEMPHY_seq_read(mp, addr, value);
 
@@ -90,11 +216,18 @@ int MEMPHY_seq_write(struct memphy_struct *mp, addr_t addr, BYTE value)
    if (mp == NULL)
       return -1;
 
-   if (!mp->rdmflg)
-      return -1; /* Not compatible mode for sequential read */
+   if (mp->rdmflg)
+      return -1; /* Not compatible mode for sequential write */
 
-   MEMPHY_mv_csr(mp, addr);
-   mp->storage[addr] = value;
+   pthread_mutex_lock(&mp->lock);
+   if (MEMPHY_mv_csr(mp, addr) < 0)
+   {
+      pthread_mutex_unlock(&mp->lock);
+      return -1;
+   }
+   *MEMPHY_ptr(mp, addr) = value;
+   mp->cursor = (addr + 1) % mp->maxsz;
+   pthread_mutex_unlock(&mp->lock);
 
    return 0;
 }
@@ -111,13 +244,135 @@ int MEMPHY_write(struct memphy_struct *mp, addr_t addr, BYTE data)
       return -1;
 
    if (mp->rdmflg)
-      mp->storage[addr] = data;
+      *MEMPHY_ptr(mp, addr) = data;
    else /* Sequential access device */
       return MEMPHY_seq_write(mp, addr, data);
 
    return 0;
 }
 
+/*
+ *  MEMPHY_read_block - read a range of MEMPHY device
+ *  @mp: memphy struct
+ *  @addr: start address
+ *  @buf: destination buffer
+ *  @size: number of bytes
+ *
+ *  The whole range is moved under one lock acquisition, a sequential
+ *  device seeks once to @addr and streams the rest.
+ */
+int MEMPHY_read_block(struct memphy_struct *mp, addr_t addr, BYTE *buf, addr_t size)
+{
+   if (mp == NULL || buf == NULL)
+      return -1;
+
+   if (addr + size > mp->maxsz || addr + size < addr)
+      return -1;
+
+   pthread_mutex_lock(&mp->lock);
+
+   if (!mp->rdmflg && MEMPHY_mv_csr(mp, addr) < 0)
+   {
+      pthread_mutex_unlock(&mp->lock);
+      return -1;
+   }
+
+   MEMPHY_copy(mp, addr, buf, size, 0);
+
+   if (!mp->rdmflg)
+      mp->cursor = (addr + size) % mp->maxsz;
+
+   pthread_mutex_unlock(&mp->lock);
+
+   return 0;
+}
+
+/*
+ *  MEMPHY_write_block - write a range of MEMPHY device
+ *  @mp: memphy struct
+ *  @addr: start address
+ *  @buf: source buffer
+ *  @size: number of bytes
+ */
+int MEMPHY_write_block(struct memphy_struct *mp, addr_t addr, const BYTE *buf, addr_t size)
+{
+   if (mp == NULL || buf == NULL)
+      return -1;
+
+   if (addr + size > mp->maxsz || addr + size < addr)
+      return -1;
+
+   pthread_mutex_lock(&mp->lock);
+
+   if (!mp->rdmflg && MEMPHY_mv_csr(mp, addr) < 0)
+   {
+      pthread_mutex_unlock(&mp->lock);
+      return -1;
+   }
+
+   MEMPHY_copy(mp, addr, (BYTE *)buf, size, 1);
+
+   if (!mp->rdmflg)
+      mp->cursor = (addr + size) % mp->maxsz;
+
+   pthread_mutex_unlock(&mp->lock);
+
+   return 0;
+}
+
+/*
+ *  MEMPHY_xchg_frame - exchange the buffers of two frames
+ *  @mpa: memphy struct
+ *  @fpna: frame of @mpa
+ *  @mpb: memphy struct
+ *  @fpnb: frame of @mpb
+ *
+ *  Moves a page between frame-indirected devices without copying it, each
+ *  frame ends up with the other's buffer. A sequential device still seeks
+ *  to its frame and streams over it.
+ */
+int MEMPHY_xchg_frame(struct memphy_struct *mpa, addr_t fpna,
+                      struct memphy_struct *mpb, addr_t fpnb)
+{
+   struct memphy_struct *first = mpa, *second = mpb;
+   BYTE *tmp;
+
+   if (mpa == NULL || mpb == NULL || mpa->frames == NULL || mpb->frames == NULL ||
+       (fpna + 1) * PAGING_PAGESZ > mpa->maxsz || (fpnb + 1) * PAGING_PAGESZ > mpb->maxsz)
+      return -1;
+
+   /* Both devices are locked, always in the same order */
+   if (mpb < mpa)
+   {
+      first = mpb;
+      second = mpa;
+   }
+   pthread_mutex_lock(&first->lock);
+   if (second != first)
+      pthread_mutex_lock(&second->lock);
+
+   if (!mpa->rdmflg)
+   {
+      MEMPHY_mv_csr(mpa, fpna * PAGING_PAGESZ);
+      mpa->cursor = ((fpna + 1) * PAGING_PAGESZ) % mpa->maxsz;
+   }
+   if (!mpb->rdmflg)
+   {
+      MEMPHY_mv_csr(mpb, fpnb * PAGING_PAGESZ);
+      mpb->cursor = ((fpnb + 1) * PAGING_PAGESZ) % mpb->maxsz;
+   }
+
+   tmp = mpa->frames[fpna];
+   mpa->frames[fpna] = mpb->frames[fpnb];
+   mpb->frames[fpnb] = tmp;
+
+   if (second != first)
+      pthread_mutex_unlock(&second->lock);
+   pthread_mutex_unlock(&first->lock);
+
+   return 0;
+}
+
 /*
  *  MEMPHY_format-format MEMPHY device
  *  @mp: memphy struct
@@ -125,16 +380,28 @@ int MEMPHY_write(struct memphy_struct *mp, addr_t addr, BYTE data)
 int MEMPHY_format(struct memphy_struct *mp, int pagesz)
 {
    /* This setting come with fixed constant PAGESZ */
-   int numfp = mp->maxsz / pagesz;
+   addr_t numfp = mp->maxsz / pagesz;
    struct framephy_struct *newfst, *fst;
-   int iter = 0;
+   addr_t iter = 0;
+
+   mp->free_fp_list = NULL;
+   mp->used_fp_list = NULL;
+   mp->mags = NULL;
+   mp->bd_order = NULL;
 
-   if (numfp <= 0)
+   if (numfp == 0)
       return -1;
 
+   mp->nr_free = numfp;
+
+   /* Small devices have too few frames to park them in per-CPU caches */
+   if (numfp >= PAGING_MAG_MINFP)
+      MEMPHY_init_mags(mp);
+
    /* Init head of free framephy list */
    fst = malloc(sizeof(struct framephy_struct));
    fst->fpn = iter;
+   fst->fp_next = NULL;
    mp->free_fp_list = fst;
 
    /* We have list with first element, fill in the rest num-1 element member*/
@@ -150,32 +417,525 @@ int MEMPHY_format(struct memphy_struct *mp, int pagesz)
    return 0;
 }
 
+/*
+ *  Buddy allocator helpers, the caller holds mp->lock
+ */
+static void MEMPHY_bd_add(struct memphy_struct *mp, addr_t fpn, int order)
+{
+   addr_t head = mp->bd_head[order];
+
+   mp->bd_order[fpn] = order;
+   mp->nr_free += (addr_t)1 << order;
+   mp->bd_prev[fpn] = PAGING_BUDDY_NIL;
+   mp->bd_next[fpn] = head;
+   if (head != PAGING_BUDDY_NIL)
+      mp->bd_prev[head] = fpn;
+   mp->bd_head[order] = fpn;
+}
+
+static void MEMPHY_bd_del(struct memphy_struct *mp, addr_t fpn, int order)
+{
+   addr_t prev = mp->bd_prev[fpn];
+   addr_t next = mp->bd_next[fpn];
+
+   if (prev != PAGING_BUDDY_NIL)
+      mp->bd_next[prev] = next;
+   else
+      mp->bd_head[order] = next;
+   if (next != PAGING_BUDDY_NIL)
+      mp->bd_prev[next] = prev;
+
+   mp->bd_order[fpn] = -1;
+   mp->nr_free -= (addr_t)1 << order;
+}
+
+static int __buddy_alloc(struct memphy_struct *mp, int order, addr_t *retfpn)
+{
+   int o = order;
+   addr_t fpn;
+
+   while (o <= PAGING_BUDDY_MAX_ORDER && mp->bd_head[o] == PAGING_BUDDY_NIL)
+      o++;
+
+   if (o > PAGING_BUDDY_MAX_ORDER)
+      return -1;
+
+   fpn = mp->bd_head[o];
+   MEMPHY_bd_del(mp, fpn, o);
+
+   /* Split down, the upper halves go back to the lower orders */
+   while (o > order)
+   {
+      o--;
+      MEMPHY_bd_add(mp, fpn + ((addr_t)1 << o), o);
+   }
+
+   *retfpn = fpn;
+   return 0;
+}
+
+static void __buddy_free(struct memphy_struct *mp, addr_t fpn, int order)
+{
+   addr_t buddy;
+
+   /* Merge with the free buddy as long as there is one */
+   while (order < PAGING_BUDDY_MAX_ORDER)
+   {
+      buddy = fpn ^ ((addr_t)1 << order);
+      if (buddy >= mp->bd_numfp || mp->bd_order[buddy] != order)
+         break;
+
+      MEMPHY_bd_del(mp, buddy, order);
+      if (buddy < fpn)
+         fpn = buddy;
+      order++;
+   }
+
+   MEMPHY_bd_add(mp, fpn, order);
+}
+
+/*
+ *  MEMPHY_buddy_format - format MEMPHY device for the buddy allocator
+ *  @mp: memphy struct
+ *  @pagesz: frame size
+ */
+int MEMPHY_buddy_format(struct memphy_struct *mp, int pagesz)
+{
+   addr_t numfp = mp->maxsz / pagesz;
+   addr_t fpn;
+   int order;
+
+   mp->free_fp_list = NULL;
+   mp->used_fp_list = NULL;
+   mp->mags = NULL;
+   mp->nr_free = 0;
+   mp->bd_order = NULL;
+
+   if (numfp == 0)
+      return -1;
+
+   mp->bd_order = malloc(numfp * sizeof(signed char));
+   mp->bd_next = malloc(numfp * sizeof(addr_t));
+   mp->bd_prev = malloc(numfp * sizeof(addr_t));
+   mp->bd_numfp = numfp;
+   if (!mp->bd_order || !mp->bd_next || !mp->bd_prev)
+      return -1;
+
+   memset(mp->bd_order, -1, numfp * sizeof(signed char));
+   for (order = 0; order <= PAGING_BUDDY_MAX_ORDER; order++)
+      mp->bd_head[order] = PAGING_BUDDY_NIL;
+
+   if (numfp >= PAGING_MAG_MINFP)
+      MEMPHY_init_mags(mp);
+
+   /* Carve the device into the largest naturally aligned blocks */
+   for (fpn = 0; fpn < numfp; fpn += (addr_t)1 << order)
+   {
+      order = PAGING_BUDDY_MAX_ORDER;
+      while (order > 0 &&
+             ((fpn & (((addr_t)1 << order) - 1)) || fpn + ((addr_t)1 << order) > numfp))
+         order--;
+      MEMPHY_bd_add(mp, fpn, order);
+   }
+
+   return 0;
+}
+
+/*
+ *  MEMPHY_drain_mags - give every CPU magazine back to the shared pool
+ *  @mp: memphy struct
+ *
+ *  Frames parked on other CPUs are invisible to the free list and, in
+ *  buddy mode, keep their buddies from merging. The caller must not hold
+ *  its own magazine lock. Returns the number of frames moved.
+ */
+static int MEMPHY_drain_mags(struct memphy_struct *mp)
+{
+   struct framephy_struct *newnode;
+   struct memphy_mag *mag;
+   int cpu, nr = 0;
+
+   if (mp->mags == NULL)
+      return 0;
+
+   for (cpu = 0; cpu < PAGING_MAX_CPU; cpu++)
+   {
+      mag = &mp->mags[cpu];
+
+      pthread_mutex_lock(&mag->lock);
+      pthread_mutex_lock(&mp->lock); // LOCKED
+      while (mag->nr > 0)
+      {
+         mag->nr--;
+         nr++;
+         if (mp->bd_order != NULL)
+         {
+            __buddy_free(mp, mag->fpn[mag->nr], 0);
+            continue;
+         }
+
+         newnode = malloc(sizeof(struct framephy_struct));
+         newnode->fpn = mag->fpn[mag->nr];
+         newnode->fp_next = mp->free_fp_list;
+         mp->free_fp_list = newnode;
+         mp->nr_free++;
+      }
+      pthread_mutex_unlock(&mp->lock); // UNLOCKED
+      pthread_mutex_unlock(&mag->lock);
+   }
+
+   return nr;
+}
+
+/*
+ *  MEMPHY_alloc_contig - allocate 2^order physically contiguous frames
+ *  @mp: memphy struct
+ *  @order: run size order
+ *  @fpn: first frame of the run, aligned to the run size
+ */
+int MEMPHY_alloc_contig(struct memphy_struct *mp, int order, addr_t *fpn)
+{
+   int ret;
+
+   if (mp == NULL || fpn == NULL || mp->bd_order == NULL ||
+       order < 0 || order > PAGING_BUDDY_MAX_ORDER)
+      return -1;
+
+   pthread_mutex_lock(&mp->lock); // LOCKED
+   ret = __buddy_alloc(mp, order, fpn);
+   pthread_mutex_unlock(&mp->lock); // UNLOCKED
+
+   /* Parked order-0 frames may be the missing buddies of the run */
+   if (ret < 0 && MEMPHY_drain_mags(mp) > 0)
+   {
+      pthread_mutex_lock(&mp->lock); // LOCKED
+      ret = __buddy_alloc(mp, order, fpn);
+      pthread_mutex_unlock(&mp->lock); // UNLOCKED
+   }
+
+   return ret;
+}
+
+/*
+ *  MEMPHY_free_contig - free a run from MEMPHY_alloc_contig
+ *  @mp: memphy struct
+ *  @fpn: first frame of the run
+ *  @order: run size order
+ */
+int MEMPHY_free_contig(struct memphy_struct *mp, addr_t fpn, int order)
+{
+   if (mp == NULL || mp->bd_order == NULL ||
+       order < 0 || order > PAGING_BUDDY_MAX_ORDER || fpn >= mp->bd_numfp)
+      return -1;
+
+   pthread_mutex_lock(&mp->lock); // LOCKED
+   __buddy_free(mp, fpn, order);
+   pthread_mutex_unlock(&mp->lock); // UNLOCKED
+
+   return 0;
+}
+
+/*
+ *  MEMPHY_mag_refill - refill a magazine from the global free list
+ *  @mp: memphy struct
+ *  @mag: magazine of the current CPU
+ *
+ *  Half a magazine is moved in one lock round-trip.
+ */
+static int MEMPHY_mag_refill(struct memphy_struct *mp, struct memphy_mag *mag)
+{
+   struct framephy_struct *fp, *chain;
+   int nr = 0;
+
+   if (mp->bd_order != NULL)
+   {
+      pthread_mutex_lock(&mp->lock); // LOCKED
+      while (mag->nr < PAGING_MAG_SZ / 2 &&
+             __buddy_alloc(mp, 0, &mag->fpn[mag->nr]) == 0)
+         mag->nr++;
+      pthread_mutex_unlock(&mp->lock); // UNLOCKED
+
+      return (mag->nr > 0) ? 0 : -1;
+   }
+
+   pthread_mutex_lock(&mp->lock); // LOCKED
+   chain = fp = mp->free_fp_list;
+   while (fp != NULL && nr < PAGING_MAG_SZ / 2)
+   {
+      mag->fpn[mag->nr++] = fp->fpn;
+      fp = fp->fp_next;
+      nr++;
+   }
+   mp->free_fp_list = fp;
+   mp->nr_free -= nr;
+   pthread_mutex_unlock(&mp->lock); // UNLOCKED
+
+   /* Release the detached nodes outside the lock */
+   while (nr-- > 0)
+   {
+      fp = chain;
+      chain = chain->fp_next;
+      free(fp);
+   }
+
+   return (mag->nr > 0) ? 0 : -1;
+}
+
+/*
+ *  MEMPHY_mag_drain - give half of a full magazine back to the free list
+ *  @mp: memphy struct
+ *  @mag: magazine of the current CPU
+ */
+static void MEMPHY_mag_drain(struct memphy_struct *mp, struct memphy_mag *mag)
+{
+   struct framephy_struct *head = NULL, *tail = NULL, *newnode;
+   addr_t nr = 0;
+
+   if (mp->bd_order != NULL)
+   {
+      pthread_mutex_lock(&mp->lock); // LOCKED
+      while (mag->nr > PAGING_MAG_SZ / 2)
+         __buddy_free(mp, mag->fpn[--mag->nr], 0);
+      pthread_mutex_unlock(&mp->lock); // UNLOCKED
+      return;
+   }
+
+   /* Build the chain outside the lock then splice it in once */
+   while (mag->nr > PAGING_MAG_SZ / 2)
+   {
+      nr++;
+      newnode = malloc(sizeof(struct framephy_struct));
+      newnode->fpn = mag->fpn[--mag->nr];
+      newnode->fp_next = head;
+      head = newnode;
+      if (tail == NULL)
+         tail = newnode;
+   }
+
+   if (head == NULL)
+      return;
+
+   pthread_mutex_lock(&mp->lock); // LOCKED
+   tail->fp_next = mp->free_fp_list;
+   mp->free_fp_list = head;
+   mp->nr_free += nr;
+   pthread_mutex_unlock(&mp->lock); // UNLOCKED
+}
+
+/*
+ *  MEMPHY_pool_get - take one frame from the shared pool of the device
+ *  @mp: memphy struct
+ *  @retfpn: returned frame number
+ */
+static int MEMPHY_pool_get(struct memphy_struct *mp, addr_t *retfpn)
+{
+   struct framephy_struct *fp;
+   int ret;
+
+   pthread_mutex_lock(&mp->lock); // LOCKED
+   if (mp->bd_order != NULL)
+   {
+      ret = __buddy_alloc(mp, 0, retfpn);
+      pthread_mutex_unlock(&mp->lock); // UNLOCKED
+      return ret;
+   }
+
+   fp = mp->free_fp_list;
+   if (fp == NULL)
+   {
+      pthread_mutex_unlock(&mp->lock); // UNLOCKED
+      return -1;
+   }
+
+   *retfpn = fp->fpn;
+   mp->free_fp_list = fp->fp_next;
+   mp->nr_free--;
+   pthread_mutex_unlock(&mp->lock); // UNLOCKED
+
+   free(fp);
+   return 0;
+}
+
 int MEMPHY_get_freefp(struct memphy_struct *mp, addr_t *retfpn)
 {
     if (mp == NULL || retfpn == NULL) {
         return -1;
     }
 
-    pthread_mutex_lock(&mp->lock); // LOCKED
+    struct memphy_mag *mag = MEMPHY_get_mag(mp);
 
-    struct framephy_struct *fp = mp->free_fp_list;
-
-    if (fp == NULL) {
-        *retfpn = (addr_t)-1;      
-        pthread_mutex_unlock(&mp->lock); // UNLOCKED
-        return -1;
+    if (mag != NULL) {
+        pthread_mutex_lock(&mag->lock);
+        if (mag->nr > 0 || MEMPHY_mag_refill(mp, mag) == 0) {
+            *retfpn = mag->fpn[--mag->nr];
+            pthread_mutex_unlock(&mag->lock);
+            return 0;
+        }
+        pthread_mutex_unlock(&mag->lock);
     }
 
-    *retfpn = fp->fpn;
-    mp->free_fp_list = fp->fp_next;
+    if (MEMPHY_pool_get(mp, retfpn) == 0)
+        return 0;
+
+    /* Other CPUs may still park free frames in their magazines */
+    if (MEMPHY_drain_mags(mp) > 0 && MEMPHY_pool_get(mp, retfpn) == 0)
+        return 0;
+
+    *retfpn = (addr_t)-1;
+    return -1;
+}
+
+/*
+ *  MEMPHY_bd_get_n - batch allocation in buddy mode
+ *
+ *  The rest of the request is served as power-of-two contiguous runs,
+ *  largest first, so the frames come out in long ascending sequences.
+ */
+static int MEMPHY_bd_get_n(struct memphy_struct *mp, struct memphy_mag *mag,
+                           addr_t *fpns, int got, int n)
+{
+   int first = got, order, iter;
+   addr_t fpn;
+
+   pthread_mutex_lock(&mp->lock); // LOCKED
+   while (got < n)
+   {
+      order = 0;
+      while (order < PAGING_BUDDY_MAX_ORDER && (1 << (order + 1)) <= n - got)
+         order++;
+
+      while (order > 0 && __buddy_alloc(mp, order, &fpn) < 0)
+         order--;
+      if (order == 0 && __buddy_alloc(mp, 0, &fpn) < 0)
+         break;
+
+      for (iter = 0; iter < (1 << order); iter++)
+         fpns[got++] = fpn + iter;
+   }
+
+   if (got < n)
+   {
+      /* Not enough frames, roll back the runs then the magazine part */
+      while (got > first)
+         __buddy_free(mp, fpns[--got], 0);
+      pthread_mutex_unlock(&mp->lock); // UNLOCKED
+      while (got > 0)
+         mag->fpn[mag->nr++] = fpns[--got];
+      return -1;
+   }
+   pthread_mutex_unlock(&mp->lock); // UNLOCKED
+
+   return 0;
+}
+
+/*
+ *  __MEMPHY_get_freefp_n - batch allocation, @mag is locked by the caller
+ *
+ *  All or nothing, the frames not served by the CPU magazine are taken
+ *  from the free list in a single lock round-trip.
+ */
+static int __MEMPHY_get_freefp_n(struct memphy_struct *mp, struct memphy_mag *mag,
+                                 int n, addr_t *fpns)
+{
+   struct framephy_struct *fp, *chain, *last = NULL;
+   int got = 0, need, iter;
+
+   if (mag != NULL)
+      while (got < n && mag->nr > 0)
+         fpns[got++] = mag->fpn[--mag->nr];
+
+   if (got == n)
+      return 0;
+
+   need = n - got;
+
+   if (mp->bd_order != NULL)
+      return MEMPHY_bd_get_n(mp, mag, fpns, got, n);
+
+   pthread_mutex_lock(&mp->lock); // LOCKED
+   chain = fp = mp->free_fp_list;
+   for (iter = 0; iter < need && fp != NULL; iter++)
+   {
+      last = fp;
+      fp = fp->fp_next;
+   }
+
+   if (iter < need)
+   {
+      pthread_mutex_unlock(&mp->lock); // UNLOCKED
+      /* Not enough frames, hand back what the magazine gave */
+      while (got > 0)
+         mag->fpn[mag->nr++] = fpns[--got];
+      return -1;
+   }
+
+   mp->free_fp_list = fp;
+   mp->nr_free -= need;
+   last->fp_next = NULL;
+   pthread_mutex_unlock(&mp->lock); // UNLOCKED
+
+   while (chain != NULL)
+   {
+      fp = chain;
+      chain = chain->fp_next;
+      fpns[got++] = fp->fpn;
+      free(fp);
+   }
+
+   return 0;
+}
+
+/*
+ *  MEMPHY_get_freefp_n - get a batch of free frames
+ *  @mp: memphy struct
+ *  @n: number of frames
+ *  @fpns: returned frame numbers
+ */
+int MEMPHY_get_freefp_n(struct memphy_struct *mp, int n, addr_t *fpns)
+{
+   struct memphy_mag *mag;
+   int ret;
 
-    free(fp);
+   if (mp == NULL || fpns == NULL || n < 0)
+      return -1;
+
+   mag = MEMPHY_get_mag(mp);
+   if (mag != NULL)
+      pthread_mutex_lock(&mag->lock);
+   ret = __MEMPHY_get_freefp_n(mp, mag, n, fpns);
+   if (mag != NULL)
+      pthread_mutex_unlock(&mag->lock);
 
-    pthread_mutex_unlock(&mp->lock); // UNLOCKED
+   /* Other CPUs may still park free frames in their magazines */
+   if (ret < 0 && MEMPHY_drain_mags(mp) > 0)
+      ret = __MEMPHY_get_freefp_n(mp, NULL, n, fpns);
 
-    return 0;   // OK
+   return ret;
 }
 
+/*
+ *  MEMPHY_get_nrfree - number of free frames, CPU magazines included
+ *  @mp: memphy struct
+ */
+addr_t MEMPHY_get_nrfree(struct memphy_struct *mp)
+{
+   addr_t nr;
+   int cpu;
+
+   pthread_mutex_lock(&mp->lock); // LOCKED
+   nr = mp->nr_free;
+   pthread_mutex_unlock(&mp->lock); // UNLOCKED
+
+   if (mp->mags != NULL)
+      for (cpu = 0; cpu < PAGING_MAX_CPU; cpu++)
+      {
+         pthread_mutex_lock(&mp->mags[cpu].lock);
+         nr += mp->mags[cpu].nr;
+         pthread_mutex_unlock(&mp->mags[cpu].lock);
+      }
+
+   return nr;
+}
 
 int MEMPHY_dump(struct memphy_struct *mp)
 {
@@ -197,6 +957,22 @@ int MEMPHY_dump(struct memphy_struct *mp)
 
 int MEMPHY_put_freefp(struct memphy_struct *mp, addr_t fpn)
 {
+   struct memphy_mag *mag = MEMPHY_get_mag(mp);
+
+   if (mag != NULL)
+   {
+      pthread_mutex_lock(&mag->lock);
+      if (mag->nr == PAGING_MAG_SZ)
+         MEMPHY_mag_drain(mp, mag);
+
+      mag->fpn[mag->nr++] = fpn;
+      pthread_mutex_unlock(&mag->lock);
+      return 0;
+   }
+
+   if (mp->bd_order != NULL)
+      return MEMPHY_free_contig(mp, fpn, 0);
+
    struct framephy_struct *newnode = malloc(sizeof(struct framephy_struct));
    /* Create new node with value fpn */
    newnode->fpn = fpn;
@@ -204,27 +980,139 @@ int MEMPHY_put_freefp(struct memphy_struct *mp, addr_t fpn)
    struct framephy_struct *fp = mp->free_fp_list;
    newnode->fp_next = fp;
    mp->free_fp_list = newnode;
+   mp->nr_free++;
    pthread_mutex_unlock(&mp->lock); // UNLOCKED
 
    return 0;
 }
 
+#ifdef MM_FRAME_INDIRECT
 /*
- *  Init MEMPHY struct
+ *  MEMPHY_init_frames - build the frame table of a heap device
+ *  @mp: memphy struct
+ *
+ *  Every frame starts on its own slice of the storage, a file mapped
+ *  device keeps its frames in file order and is not indirected.
  */
-int init_memphy(struct memphy_struct *mp, addr_t max_size, int randomflg)
+static void MEMPHY_init_frames(struct memphy_struct *mp)
+{
+   addr_t fpn, numfp = mp->maxsz / PAGING_PAGESZ;
+
+   if (numfp == 0 || mp->maxsz % PAGING_PAGESZ != 0)
+      return;
+
+   mp->frames = malloc(numfp * sizeof(BYTE *));
+   if (mp->frames == NULL)
+      return;
+
+   for (fpn = 0; fpn < numfp; fpn++)
+      mp->frames[fpn] = mp->storage + fpn * PAGING_PAGESZ;
+}
+#endif
+
+/*
+ *  MEMPHY_init_dev - common device fields of every init flavour
+ */
+static void MEMPHY_init_dev(struct memphy_struct *mp, BYTE *storage, addr_t max_size,
+                            int fd, int randomflg)
 {
    pthread_mutex_init(&mp->lock, NULL);
-   mp->storage = (BYTE *)malloc(max_size * sizeof(BYTE));
+   mp->storage = storage;
    mp->maxsz = max_size;
-   memset(mp->storage, 0, max_size * sizeof(BYTE));
+   mp->fd = fd;
+
+   mp->rdmflg = (randomflg != 0) ? 1 : 0;
+
+   /* Not Ramdom acess device, then it serial device*/
+   mp->cursor = 0;
+   mp->seekcost = 0;
+
+   mp->pgdesc = NULL;
+   mp->zerofpn = PAGING_FPN_NIL;
+   mp->nr_free = 0;
+   mp->frames = NULL;
+
+#ifdef MM_FRAME_INDIRECT
+   if (fd < 0)
+      MEMPHY_init_frames(mp);
+#endif
+}
+
+/*
+ *  Init MEMPHY struct
+ */
+int init_memphy(struct memphy_struct *mp, addr_t max_size, int randomflg)
+{
+   BYTE *storage = (BYTE *)malloc(max_size * sizeof(BYTE));
+
+   memset(storage, 0, max_size * sizeof(BYTE));
+   MEMPHY_init_dev(mp, storage, max_size, -1, randomflg);
 
    MEMPHY_format(mp, PAGING_PAGESZ);
 
-   mp->rdmflg = (randomflg != 0) ? 1 : 0;
+   return 0;
+}
+
+/*
+ *  init_memphy_buddy - init MEMPHY struct managed by the buddy allocator
+ *  @mp: memphy struct
+ *  @max_size: device size
+ *  @randomflg: random access device flag
+ */
+int init_memphy_buddy(struct memphy_struct *mp, addr_t max_size, int randomflg)
+{
+   BYTE *storage = (BYTE *)malloc(max_size * sizeof(BYTE));
+
+   memset(storage, 0, max_size * sizeof(BYTE));
+   MEMPHY_init_dev(mp, storage, max_size, -1, randomflg);
+
+   return MEMPHY_buddy_format(mp, PAGING_PAGESZ);
+}
+
+/*
+ *  init_memphy_file - init MEMPHY struct backed by a memory-mapped file
+ *  @mp: memphy struct
+ *  @max_size: device size, the file is created or truncated to it
+ *  @randomflg: random access device flag
+ *  @path: backing file path
+ *
+ *  Only swap devices are file-backed, their slots come from the swap area
+ *  bitmaps so no frame list is built for them.
+ */
+int init_memphy_file(struct memphy_struct *mp, addr_t max_size, int randomflg, const char *path)
+{
+   void *map;
+   int fd;
+
+   if (max_size == 0) /* Nothing to map, keep the empty device on heap */
+      return init_memphy(mp, max_size, randomflg);
+
+   fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+   if (fd < 0)
+      return -1;
+
+   /* The truncated file is sparse and reads back as zero,
+    * host disk blocks are only consumed by written frames */
+   if (ftruncate(fd, max_size) < 0)
+   {
+      close(fd);
+      return -1;
+   }
+
+   map = mmap(NULL, max_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (map == MAP_FAILED)
+   {
+      close(fd);
+      return -1;
+   }
+
+   MEMPHY_init_dev(mp, (BYTE *)map, max_size, fd, randomflg);
 
-   if (!mp->rdmflg) /* Not Ramdom acess device, then it serial device*/
-      mp->cursor = 0;
+   /* No per-frame nodes, host heap does not grow with the file size */
+   mp->free_fp_list = NULL;
+   mp->used_fp_list = NULL;
+   mp->mags = NULL;
+   mp->bd_order = NULL;
 
    return 0;
 }
@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+#ifdef MM_PAGING
+/*
+ * PAGING based Memory Management
+ * Swap area module mm/mm-swap.c
+ *
+ * Every configured swap device is a swap area with its own slot bitmap.
+ * The swap type of a swapped PTE is the index of the area holding the
+ * page and the swap offset is the slot in that area. Slots are handed
+ * out by priority, the higher priority area fills first and areas of
+ * equal priority take turns, or striped round-robin over every area.
+ *
+ * Inside an area slots come from a reserved cluster of PAGING_SWAP_CLUSTER
+ * free slots, so consecutive swap-outs land next to each other. Once no
+ * free cluster is left the area falls back to the first free slots.
+ */
+
+#include "mm.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SWAP_MAP_BITS 32
+#define SWAP_CLUSTER_WORDS (PAGING_SWAP_CLUSTER / SWAP_MAP_BITS)
+
+#define swap_slot_used(si, s) ((si)->map[(s) / SWAP_MAP_BITS] & (1U << ((s) % SWAP_MAP_BITS)))
+
+/*
+ *  swap_map_find - first free slot of an area from its hint, wrapping
+ */
+static int swap_map_find(struct swap_info_struct *si, addr_t *slot)
+{
+   addr_t nwords = (si->nslots + SWAP_MAP_BITS - 1) / SWAP_MAP_BITS;
+   addr_t w = si->hint / SWAP_MAP_BITS;
+   addr_t iter, s;
+   uint32_t free;
+
+   for (iter = 0; iter <= nwords; iter++, w = (w + 1 == nwords) ? 0 : w + 1)
+   {
+      free = ~si->map[w];
+      if (free == 0)
+         continue;
+
+      for (s = w * SWAP_MAP_BITS; free != 0; free >>= 1, s++)
+      {
+         if (!(free & 1))
+            continue;
+         if (s >= si->nslots)
+            break;
+         *slot = s;
+         return 0;
+      }
+   }
+
+   return -1;
+}
+
+/*
+ *  swap_cluster_find - reserve the next wholly free cluster of an area
+ */
+static int swap_cluster_find(struct swap_info_struct *si)
+{
+   addr_t nclu = si->nslots / PAGING_SWAP_CLUSTER;
+   addr_t c = (si->hint / PAGING_SWAP_CLUSTER) % (nclu ? nclu : 1);
+   addr_t iter, w;
+
+   for (iter = 0; iter < nclu; iter++, c = (c + 1 == nclu) ? 0 : c + 1)
+   {
+      for (w = 0; w < SWAP_CLUSTER_WORDS; w++)
+         if (si->map[c * SWAP_CLUSTER_WORDS + w] != 0)
+            break;
+
+      if (w == SWAP_CLUSTER_WORDS)
+      {
+         si->clu_next = c * PAGING_SWAP_CLUSTER;
+         si->clu_end = si->clu_next + PAGING_SWAP_CLUSTER;
+         return 0;
+      }
+   }
+
+   return -1;
+}
+
+/*
+ *  swap_pick - area of the next slot under the configured policy
+ */
+static int swap_pick(struct swap_struct *swp)
+{
+   int iter, type, best = -1;
+
+   if (swp->policy == PAGING_SWAP_STRIPE)
+   {
+      for (iter = 0; iter < swp->nr; iter++)
+      {
+         type = (swp->next + iter) % swp->nr;
+         if (swp->info[type].nfree > 0)
+         {
+            swp->next = (type + 1) % swp->nr;
+            return type;
+         }
+      }
+      return -1;
+   }
+
+   /* Highest priority first, the cursor rotates equal priorities */
+   for (iter = 0; iter < swp->nr; iter++)
+   {
+      type = (swp->next + iter) % swp->nr;
+      if (swp->info[type].nfree == 0)
+         continue;
+      if (best < 0 || swp->info[type].prio > swp->info[best].prio)
+         best = type;
+   }
+
+   if (best >= 0)
+      swp->next = (best + 1) % swp->nr;
+   return best;
+}
+
+/*
+ *  swap_init - set up the swap areas of the swap devices
+ *  @swp: swap areas
+ *  @devs: swap devices, the device index becomes the swap type
+ *  @nr: number of devices
+ *  @policy: PAGING_SWAP_PRIO or PAGING_SWAP_STRIPE
+ *
+ *  Devices are taken as listed from the fastest, so an earlier device
+ *  gets a higher priority. A device of size zero is kept as an empty area.
+ *  The compressed pool starts disabled, zswap_init() sizes it.
+ */
+int swap_init(struct swap_struct *swp, struct memphy_struct **devs, int nr, int policy)
+{
+   struct swap_info_struct *si;
+   int type;
+
+   if (nr > PAGING_MAX_MMSWP)
+      nr = PAGING_MAX_MMSWP;
+
+   swp->nr = nr;
+   swp->policy = policy;
+   swp->next = 0;
+   pthread_mutex_init(&swp->lock, NULL);
+   zswap_init(&swp->zpool, 0);
+
+   for (type = 0; type < nr; type++)
+   {
+      si = &swp->info[type];
+      si->dev = devs[type];
+      si->prio = nr - type;
+      si->nslots = (si->dev != NULL) ? si->dev->maxsz / PAGING_PAGESZ : 0;
+      si->nfree = si->nslots;
+      si->hint = 0;
+      si->clu_next = si->clu_end = 0;
+      si->map = calloc((si->nslots + SWAP_MAP_BITS - 1) / SWAP_MAP_BITS + 1,
+                       sizeof(uint32_t));
+      if (si->map == NULL)
+         return -1;
+   }
+
+   return 0;
+}
+
+/*
+ *  swap_alloc_n - allocate a run of adjacent swap slots
+ *  @swp: swap areas
+ *  @n: wanted number of slots
+ *  @swptyp: return swap type, the area index
+ *  @swpoff: return first slot of the run
+ *
+ *  The run stays on one area and may be shorter than @n, the number of
+ *  slots it holds is returned, -1 when every area is full.
+ */
+int swap_alloc_n(struct swap_struct *swp, int n, int *swptyp, addr_t *swpoff)
+{
+   struct swap_info_struct *si;
+   addr_t s;
+   int type, got;
+
+   pthread_mutex_lock(&swp->lock); // LOCKED
+   type = swap_pick(swp);
+   if (type < 0)
+   {
+      pthread_mutex_unlock(&swp->lock); // UNLOCKED
+      return -1;
+   }
+
+   si = &swp->info[type];
+   if (si->clu_next < si->clu_end || swap_cluster_find(si) == 0)
+   {
+      /* The rest of a reserved cluster is free by construction */
+      s = si->clu_next;
+      got = (si->clu_end - s < (addr_t)n) ? (int)(si->clu_end - s) : n;
+      si->clu_next += got;
+   }
+   else
+   {
+      /* nfree and the map disagree, do not hand out a random slot */
+      if (swap_map_find(si, &s) != 0)
+      {
+         pthread_mutex_unlock(&swp->lock); // UNLOCKED
+         return -1;
+      }
+      got = 1;
+      while (got < n && s + got < si->nslots && !swap_slot_used(si, s + got))
+         got++;
+   }
+
+   for (*swpoff = s; s < *swpoff + got; s++)
+      si->map[s / SWAP_MAP_BITS] |= 1U << (s % SWAP_MAP_BITS);
+   si->nfree -= got;
+   si->hint = s < si->nslots ? s : 0;
+   pthread_mutex_unlock(&swp->lock); // UNLOCKED
+
+   *swptyp = type;
+#ifdef IODUMP
+   printf("\tswap slots MEMSWP %d offset " FORMAT_ADDR " count %d\n", type, *swpoff, got);
+#endif
+   return got;
+}
+
+/*
+ *  swap_alloc - allocate a swap slot
+ *  @swp: swap areas
+ *  @swptyp: return swap type, the area index
+ *  @swpoff: return slot in the area
+ */
+int swap_alloc(struct swap_struct *swp, int *swptyp, addr_t *swpoff)
+{
+   return (swap_alloc_n(swp, 1, swptyp, swpoff) == 1) ? 0 : -1;
+}
+
+/*
+ *  swap_free - release a swap slot
+ *  @swp: swap areas
+ *  @swptyp: swap type
+ *  @swpoff: slot in the area
+ */
+int swap_free(struct swap_struct *swp, int swptyp, addr_t swpoff)
+{
+   struct swap_info_struct *si;
+   uint32_t bit;
+
+   if (swptyp < 0 || swptyp >= swp->nr)
+      return -1;
+
+   si = &swp->info[swptyp];
+   if (swpoff >= si->nslots)
+      return -1;
+
+   bit = 1U << (swpoff % SWAP_MAP_BITS);
+
+   pthread_mutex_lock(&swp->lock); // LOCKED
+   if (!(si->map[swpoff / SWAP_MAP_BITS] & bit))
+   {
+      pthread_mutex_unlock(&swp->lock); // UNLOCKED
+      return -1;
+   }
+   si->map[swpoff / SWAP_MAP_BITS] &= ~bit;
+   si->nfree++;
+   pthread_mutex_unlock(&swp->lock); // UNLOCKED
+
+   return 0;
+}
+
+/*
+ *  swap_dev - device of a swap type
+ *  @swp: swap areas
+ *  @swptyp: swap type
+ */
+struct memphy_struct *swap_dev(struct swap_struct *swp, int swptyp)
+{
+   if (swptyp < 0 || swptyp >= swp->nr)
+      return NULL;
+
+   return swp->info[swptyp].dev;
+}
+
+#endif
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+#ifdef MM_PAGING
+/*
+ * PAGING based Memory Management
+ * Software TLB module mm/mm-tlb.c
+ */
+
+#include "mm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+struct tlb_entry {
+   int valid;
+   uint32_t pid;           /* ASID tag */
+   struct mm_struct *mm;   /* page table the entry was filled from */
+   addr_t pgn;
+   addr_t pte;
+   int order;              /* huge entries: log2 of the pages covered */
+};
+
+struct tlb_struct {
+   struct tlb_entry set[PAGING_TLB_SETS][PAGING_TLB_WAYS];
+   int next[PAGING_TLB_SETS];  /* round-robin victim way per set */
+
+   /* Huge mappings, keyed by the first page and its frame run */
+   struct tlb_entry huge[PAGING_TLB_HUGE_WAYS];
+   int hnext;
+
+   uint64_t hits;
+   uint64_t misses;
+
+   /* Owner CPU does lookups and fills, other CPUs only shoot down */
+   pthread_mutex_t lock;
+};
+
+static struct tlb_struct tlb[PAGING_MAX_CPU];
+static pthread_once_t tlb_once = PTHREAD_ONCE_INIT;
+
+static void tlb_init(void)
+{
+   int cpu;
+
+   for (cpu = 0; cpu < PAGING_MAX_CPU; cpu++)
+      pthread_mutex_init(&tlb[cpu].lock, NULL);
+}
+
+/*
+ *  tlb_get - TLB of the calling CPU, NULL outside CPU threads
+ */
+static struct tlb_struct *tlb_get(void)
+{
+   int cpu = MEMPHY_get_cpu();
+
+   if (cpu < 0 || cpu >= PAGING_MAX_CPU)
+      return NULL;
+
+   pthread_once(&tlb_once, tlb_init);
+   return &tlb[cpu];
+}
+
+/*
+ *  tlb_huge_match - huge entry covering a page
+ */
+static int tlb_huge_match(struct tlb_entry *e, struct mm_struct *mm, addr_t pgn)
+{
+   return e->valid && e->mm == mm && (pgn >> e->order) == (e->pgn >> e->order);
+}
+
+/*
+ *  tlb_lookup - translate a page through the TLB of the calling CPU
+ *  @mm: page table of the caller
+ *  @pid: caller PID used as ASID
+ *  @pgn: page number
+ *  @pte: returned cached page table entry
+ *
+ *  Return 0 on hit, -1 on miss.
+ */
+int tlb_lookup(struct mm_struct *mm, uint32_t pid, addr_t pgn, addr_t *pte)
+{
+   struct tlb_struct *t = tlb_get();
+   struct tlb_entry *e;
+   int way, ret = -1;
+
+   if (t == NULL)
+      return -1;
+
+   pthread_mutex_lock(&t->lock);
+   e = t->set[pgn % PAGING_TLB_SETS];
+   for (way = 0; way < PAGING_TLB_WAYS; way++)
+   {
+      if (e[way].valid && e[way].pid == pid && e[way].mm == mm && e[way].pgn == pgn)
+      {
+         *pte = e[way].pte;
+         ret = 0;
+         break;
+      }
+   }
+
+   for (way = 0; ret != 0 && way < PAGING_TLB_HUGE_WAYS; way++)
+   {
+      e = &t->huge[way];
+      if (e->pid == pid && tlb_huge_match(e, mm, pgn))
+      {
+         addr_t fpn = PAGING_PTE_FPN(e->pte) + (pgn - e->pgn);
+
+         *pte = e->pte;
+         SETVAL(*pte, fpn, PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
+         ret = 0;
+      }
+   }
+
+   if (ret == 0)
+      t->hits++;
+   else
+      t->misses++;
+   pthread_mutex_unlock(&t->lock);
+
+   return ret;
+}
+
+/*
+ *  tlb_fill - cache a translation after a page table walk
+ *  @mm: page table the entry was read from
+ *  @pid: caller PID used as ASID
+ *  @pgn: page number
+ *  @pte: page table entry
+ */
+int tlb_fill(struct mm_struct *mm, uint32_t pid, addr_t pgn, addr_t pte)
+{
+   struct tlb_struct *t = tlb_get();
+   struct tlb_entry *e;
+   int setidx = pgn % PAGING_TLB_SETS;
+   int way;
+
+   if (t == NULL)
+      return -1;
+
+   pthread_mutex_lock(&t->lock);
+   e = t->set[setidx];
+
+   /* Refresh an existing entry, else take a free way, else round-robin */
+   for (way = 0; way < PAGING_TLB_WAYS; way++)
+      if (e[way].valid && e[way].pid == pid && e[way].mm == mm && e[way].pgn == pgn)
+         break;
+
+   if (way == PAGING_TLB_WAYS)
+      for (way = 0; way < PAGING_TLB_WAYS; way++)
+         if (!e[way].valid)
+            break;
+
+   if (way == PAGING_TLB_WAYS)
+   {
+      way = t->next[setidx];
+      t->next[setidx] = (way + 1) % PAGING_TLB_WAYS;
+   }
+
+   e[way].valid = 1;
+   e[way].pid = pid;
+   e[way].mm = mm;
+   e[way].pgn = pgn;
+   e[way].pte = pte;
+   e[way].order = 0;
+   pthread_mutex_unlock(&t->lock);
+
+   return 0;
+}
+
+/*
+ *  tlb_fill_huge - cache a huge mapping after a page table walk
+ *  @mm: page table the entry was read from
+ *  @pid: caller PID used as ASID
+ *  @pgn: any page of the huge mapping
+ *  @pte: page table entry built for @pgn
+ *  @order: log2 of the pages the mapping covers
+ *
+ *  One entry serves every page of the mapping.
+ */
+int tlb_fill_huge(struct mm_struct *mm, uint32_t pid, addr_t pgn, addr_t pte, int order)
+{
+   struct tlb_struct *t = tlb_get();
+   struct tlb_entry *e = NULL;
+   addr_t off = pgn & ((1ULL << order) - 1);
+   int way;
+
+   if (t == NULL)
+      return -1;
+
+   pthread_mutex_lock(&t->lock);
+   for (way = 0; way < PAGING_TLB_HUGE_WAYS; way++)
+      if (!t->huge[way].valid)
+         break;
+
+   if (way == PAGING_TLB_HUGE_WAYS)
+   {
+      way = t->hnext;
+      t->hnext = (way + 1) % PAGING_TLB_HUGE_WAYS;
+   }
+
+   e = &t->huge[way];
+   e->valid = 1;
+   e->pid = pid;
+   e->mm = mm;
+   e->pgn = pgn - off;
+   e->pte = pte;
+   SETVAL(e->pte, (PAGING_PTE_FPN(pte) - off), PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
+   e->order = order;
+   pthread_mutex_unlock(&t->lock);
+
+   return 0;
+}
+
+/*
+ *  tlb_invalidate - shoot down a page on every CPU
+ *  @mm: page table whose entry changed
+ *  @pgn: page number
+ *
+ *  Every process sharing @mm loses the entry whatever its PID,
+ *  a huge entry covering @pgn is dropped as well.
+ */
+int tlb_invalidate(struct mm_struct *mm, addr_t pgn)
+{
+   struct tlb_entry *e;
+   int cpu, way;
+
+   pthread_once(&tlb_once, tlb_init);
+
+   for (cpu = 0; cpu < PAGING_MAX_CPU; cpu++)
+   {
+      pthread_mutex_lock(&tlb[cpu].lock);
+      e = tlb[cpu].set[pgn % PAGING_TLB_SETS];
+      for (way = 0; way < PAGING_TLB_WAYS; way++)
+         if (e[way].valid && e[way].mm == mm && e[way].pgn == pgn)
+            e[way].valid = 0;
+      for (way = 0; way < PAGING_TLB_HUGE_WAYS; way++)
+         if (tlb_huge_match(&tlb[cpu].huge[way], mm, pgn))
+            tlb[cpu].huge[way].valid = 0;
+      pthread_mutex_unlock(&tlb[cpu].lock);
+   }
+
+   return 0;
+}
+
+/*
+ *  tlb_invalidate_range - shoot down a run of pages on every CPU
+ *  @mm: page table whose entries changed
+ *  @pgn: first page number
+ *  @pgnum: number of pages
+ *
+ *  Each CPU is locked once and its entries are scanned against the run.
+ */
+int tlb_invalidate_range(struct mm_struct *mm, addr_t pgn, addr_t pgnum)
+{
+   struct tlb_entry *e;
+   int cpu, s, way;
+
+   if (pgnum == 1)
+      return tlb_invalidate(mm, pgn);
+
+   pthread_once(&tlb_once, tlb_init);
+
+   for (cpu = 0; cpu < PAGING_MAX_CPU; cpu++)
+   {
+      pthread_mutex_lock(&tlb[cpu].lock);
+      for (s = 0; s < PAGING_TLB_SETS; s++)
+      {
+         e = tlb[cpu].set[s];
+         for (way = 0; way < PAGING_TLB_WAYS; way++)
+            if (e[way].valid && e[way].mm == mm && e[way].pgn - pgn < pgnum)
+               e[way].valid = 0;
+      }
+
+      for (way = 0; way < PAGING_TLB_HUGE_WAYS; way++)
+      {
+         e = &tlb[cpu].huge[way];
+         if (e->valid && e->mm == mm && e->pgn < pgn + pgnum &&
+             pgn < e->pgn + (1ULL << e->order))
+            e->valid = 0;
+      }
+      pthread_mutex_unlock(&tlb[cpu].lock);
+   }
+
+   return 0;
+}
+
+/*
+ *  tlb_get_stats - hit and miss counters of a CPU TLB
+ *  @cpuid: CPU id
+ *  @hits: returned hit count
+ *  @misses: returned miss count
+ */
+int tlb_get_stats(int cpuid, uint64_t *hits, uint64_t *misses)
+{
+   if (cpuid < 0 || cpuid >= PAGING_MAX_CPU)
+      return -1;
+
+   pthread_once(&tlb_once, tlb_init);
+
+   pthread_mutex_lock(&tlb[cpuid].lock);
+   *hits = tlb[cpuid].hits;
+   *misses = tlb[cpuid].misses;
+   pthread_mutex_unlock(&tlb[cpuid].lock);
+
+   return 0;
+}
+
+#endif
@@ -46,9 +46,14 @@ struct vm_area_struct *get_vma_by_num(struct mm_struct *mm, int vmaid)
   return pvma;
 }
 
-int __mm_swap_page(struct pcb_t *caller, addr_t vicfpn , addr_t swpfpn)
+int __mm_swap_page(struct pcb_t *caller, addr_t vicfpn , int swptyp, addr_t swpfpn)
 {
-    __swap_cp_page(caller->krnl->mram, vicfpn, caller->krnl->active_mswp, swpfpn);
+    struct memphy_struct *mswp = swap_dev(caller->krnl->swap, swptyp);
+
+    if (mswp == NULL)
+      return -1;
+
+    __swap_mv_page(caller->krnl->mram, vicfpn, mswp, swpfpn);
     return 0;
 }
 
@@ -160,6 +165,13 @@ int inc_vma_limit(struct pcb_t *caller, int vmaid, addr_t inc_sz)
 
   cur_vma->vm_end += inc_amt;
 
+#ifdef MM_DEMAND_PAGING
+  /* Frames are allocated by pg_getpage on first access */
+  (void)old_end;
+  (void)incnumpage;
+  return 0;
+#endif
+
   struct vm_rg_struct *newrg = malloc(sizeof(struct vm_rg_struct));
   if (newrg == NULL) {
     return -1;
@@ -167,7 +179,10 @@ int inc_vma_limit(struct pcb_t *caller, int vmaid, addr_t inc_sz)
 
   if (vm_map_ram(caller,
                  area->rg_start, area->rg_end,
-                 old_end, incnumpage, newrg) < 0) {
+                 old_end, incnumpage, newrg) != 0) {
+    /* Nothing stays mapped, give the range back */
+    cur_vma->vm_end = old_end;
+    free(newrg);
     return -1;
   }
 
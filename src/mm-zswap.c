@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+#ifdef MM_PAGING
+/*
+ * PAGING based Memory Management
+ * Compressed swap pool module mm/mm-zswap.c
+ *
+ * Evicted pages are kept compressed in host memory in front of the swap
+ * devices. A page filled with one byte value only keeps that byte, any
+ * other page is run-length coded. A page that does not shrink enough, or
+ * does not fit in the pool, is rejected and goes to a swap device.
+ * The PTE of a pooled page has swap type PAGING_SWP_ZSWAP and its swap
+ * offset is the pool entry.
+ */
+
+#include "mm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ZSWAP_RUN_MAX 130    /* control 128..255 repeats 3..130 bytes */
+#define ZSWAP_LIT_MAX 128    /* control 0..127 copies 1..128 bytes */
+
+/*
+ *  zswap_encode - run-length code a page
+ *  @src: page
+ *  @n: page size
+ *  @dst: output buffer
+ *  @cap: output buffer size
+ *
+ *  Returns the coded length, 0 when it does not fit in @cap.
+ */
+static addr_t zswap_encode(const BYTE *src, addr_t n, BYTE *dst, addr_t cap)
+{
+   addr_t i = 0, o = 0, run, lit;
+
+   while (i < n)
+   {
+      run = 1;
+      while (i + run < n && run < ZSWAP_RUN_MAX && src[i + run] == src[i])
+         run++;
+
+      if (run >= 3)
+      {
+         if (o + 2 > cap)
+            return 0;
+         dst[o++] = (BYTE)(run + 125);
+         dst[o++] = src[i];
+         i += run;
+         continue;
+      }
+
+      /* Literals up to the next run of three */
+      lit = 0;
+      while (i + lit < n && lit < ZSWAP_LIT_MAX &&
+             !(i + lit + 2 < n && src[i + lit] == src[i + lit + 1] &&
+               src[i + lit] == src[i + lit + 2]))
+         lit++;
+
+      if (o + 1 + lit > cap)
+         return 0;
+      dst[o++] = (BYTE)(lit - 1);
+      memcpy(dst + o, src + i, lit);
+      o += lit;
+      i += lit;
+   }
+
+   return o;
+}
+
+/*
+ *  zswap_decode - expand a run-length coded page
+ */
+static int zswap_decode(const BYTE *src, addr_t len, BYTE *dst, addr_t n)
+{
+   addr_t i = 0, o = 0, cnt;
+   unsigned char c;
+
+   while (i < len)
+   {
+      c = (unsigned char)src[i++];
+      if (c < ZSWAP_LIT_MAX)
+      {
+         cnt = c + 1;
+         if (o + cnt > n || i + cnt > len)
+            return -1;
+         memcpy(dst + o, src + i, cnt);
+         i += cnt;
+      }
+      else
+      {
+         cnt = c - 125;
+         if (o + cnt > n || i >= len)
+            return -1;
+         memset(dst + o, src[i++], cnt);
+      }
+      o += cnt;
+   }
+
+   return (o == n) ? 0 : -1;
+}
+
+/*
+ *  zswap_same_filled - check a page holds a single byte value
+ */
+static int zswap_same_filled(const BYTE *page, addr_t n)
+{
+   addr_t i;
+
+   for (i = 1; i < n; i++)
+      if (page[i] != page[0])
+         return 0;
+
+   return 1;
+}
+
+/*
+ *  zswap_get_entry - take a free pool entry, growing the table if needed
+ *  caller holds zp->lock
+ */
+static int zswap_get_entry(struct zswap_pool *zp, addr_t *idx)
+{
+   struct zswap_entry *tbl;
+   addr_t nr, i;
+
+   if (zp->free == PAGING_FPN_NIL)
+   {
+      nr = zp->nr ? 2 * zp->nr : 64;
+      tbl = realloc(zp->tbl, nr * sizeof(struct zswap_entry));
+      if (tbl == NULL)
+         return -1;
+
+      for (i = zp->nr; i < nr; i++)
+      {
+         tbl[i].data = NULL;
+         tbl[i].len = 0;
+         tbl[i].used = 0;
+         tbl[i].next = (i + 1 < nr) ? i + 1 : PAGING_FPN_NIL;
+      }
+      zp->free = zp->nr;
+      zp->tbl = tbl;
+      zp->nr = nr;
+   }
+
+   *idx = zp->free;
+   zp->free = zp->tbl[*idx].next;
+   return 0;
+}
+
+/*
+ *  zswap_init - set up an empty compressed pool
+ *  @zp: pool
+ *  @maxsz: bytes of compressed data the pool may hold
+ */
+int zswap_init(struct zswap_pool *zp, addr_t maxsz)
+{
+   zp->tbl = NULL;
+   zp->nr = 0;
+   zp->free = PAGING_FPN_NIL;
+   zp->maxsz = maxsz;
+   zp->size = 0;
+   zp->stored = zp->rejected = 0;
+   pthread_mutex_init(&zp->lock, NULL);
+
+   return 0;
+}
+
+/*
+ *  __zswap_store - compress a page into the pool, uncounted
+ */
+static int __zswap_store(struct zswap_pool *zp, const BYTE *page, addr_t *idx)
+{
+   BYTE buf[PAGING_PAGESZ * 3 / 4];
+   struct zswap_entry *ent;
+   addr_t len = 0;
+   int same;
+
+   if (zp->maxsz == 0)
+      return -1;
+
+   same = zswap_same_filled(page, PAGING_PAGESZ);
+   if (!same)
+   {
+      len = zswap_encode(page, PAGING_PAGESZ, buf, sizeof(buf));
+      if (len == 0)
+         return -1;
+   }
+
+   /* Every entry is charged, same-filled ones included, so they cannot
+    * grow the pool past its size */
+   pthread_mutex_lock(&zp->lock); // LOCKED
+   if (zp->size + len + PAGING_ZSWAP_ENTRY_COST > zp->maxsz ||
+       zswap_get_entry(zp, idx) != 0)
+   {
+      pthread_mutex_unlock(&zp->lock); // UNLOCKED
+      return -1;
+   }
+
+   ent = &zp->tbl[*idx];
+   ent->data = NULL;
+   if (!same)
+   {
+      ent->data = malloc(len);
+      if (ent->data == NULL)
+      {
+         ent->next = zp->free;
+         zp->free = *idx;
+         pthread_mutex_unlock(&zp->lock); // UNLOCKED
+         return -1;
+      }
+      memcpy(ent->data, buf, len);
+   }
+   ent->used = 1;
+   ent->len = len;
+   ent->fill = page[0];
+   zp->size += len + PAGING_ZSWAP_ENTRY_COST;
+   pthread_mutex_unlock(&zp->lock); // UNLOCKED
+
+   return 0;
+}
+
+/*
+ *  zswap_store - compress a page into the pool
+ *  @zp: pool
+ *  @page: page content, PAGING_PAGESZ bytes
+ *  @idx: return pool entry
+ *
+ *  Returns -1 when the page is rejected, it then goes to a swap device.
+ */
+int zswap_store(struct zswap_pool *zp, const BYTE *page, addr_t *idx)
+{
+   int ret = __zswap_store(zp, page, idx);
+
+   pthread_mutex_lock(&zp->lock); // LOCKED
+   if (ret == 0)
+      zp->stored++;
+   else
+      zp->rejected++;
+   pthread_mutex_unlock(&zp->lock); // UNLOCKED
+
+   return ret;
+}
+
+/*
+ *  zswap_load - decompress a pooled page
+ *  @zp: pool
+ *  @idx: pool entry
+ *  @page: output page, PAGING_PAGESZ bytes
+ */
+int zswap_load(struct zswap_pool *zp, addr_t idx, BYTE *page)
+{
+   struct zswap_entry *ent;
+   int ret = 0;
+
+   pthread_mutex_lock(&zp->lock); // LOCKED
+   if (idx >= zp->nr || !zp->tbl[idx].used)
+   {
+      pthread_mutex_unlock(&zp->lock); // UNLOCKED
+      return -1;
+   }
+
+   ent = &zp->tbl[idx];
+   if (ent->data == NULL)
+      memset(page, ent->fill, PAGING_PAGESZ);
+   else
+      ret = zswap_decode(ent->data, ent->len, page, PAGING_PAGESZ);
+   pthread_mutex_unlock(&zp->lock); // UNLOCKED
+
+   return ret;
+}
+
+/*
+ *  zswap_free - release a pool entry
+ *  @zp: pool
+ *  @idx: pool entry
+ */
+int zswap_free(struct zswap_pool *zp, addr_t idx)
+{
+   struct zswap_entry *ent;
+
+   pthread_mutex_lock(&zp->lock); // LOCKED
+   if (idx >= zp->nr || !zp->tbl[idx].used)
+   {
+      pthread_mutex_unlock(&zp->lock); // UNLOCKED
+      return -1;
+   }
+
+   ent = &zp->tbl[idx];
+   free(ent->data);
+   ent->data = NULL;
+   zp->size -= ent->len + PAGING_ZSWAP_ENTRY_COST;
+   ent->used = 0;
+   ent->next = zp->free;
+   zp->free = idx;
+   pthread_mutex_unlock(&zp->lock); // UNLOCKED
+
+   return 0;
+}
+
+/*
+ *  zswap_get_stats - usage and traffic of the pool
+ *  @zp: pool
+ *  @size: returned bytes held, entry cost included
+ *  @stored: returned number of pages taken in
+ *  @rejected: returned number of pages turned away
+ */
+int zswap_get_stats(struct zswap_pool *zp, addr_t *size, addr_t *stored, addr_t *rejected)
+{
+   pthread_mutex_lock(&zp->lock); // LOCKED
+   *size = zp->size;
+   *stored = zp->stored;
+   *rejected = zp->rejected;
+   pthread_mutex_unlock(&zp->lock); // UNLOCKED
+
+   return 0;
+}
+
+#endif
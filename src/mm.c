@@ -122,19 +122,45 @@ int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
 
   SETBIT(*pte, PAGING_PTE_PRESENT_MASK);
   CLRBIT(*pte, PAGING_PTE_SWAPPED_MASK);
+  CLRBIT(*pte, PAGING_PTE_RDONLY_MASK);
 
   SETVAL(*pte, fpn, PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
 
   return 0;
 }
 
+int pte_set_bits(struct pcb_t *caller, addr_t pgn, addr_t mask)
+{
+  SETBIT(caller->krnl->mm->pgd[pgn], mask);
+  return 0;
+}
+
+int pte_clr_bits(struct pcb_t *caller, addr_t pgn, addr_t mask)
+{
+  CLRBIT(caller->krnl->mm->pgd[pgn], mask);
+  return 0;
+}
+
+/*
+ * pte_set_rdonly - Write-protect an on-line page
+ * @pgn   : page number
+ */
+int pte_set_rdonly(struct pcb_t *caller, addr_t pgn)
+{
+  struct krnl_t *krnl = caller->krnl;
+
+  SETBIT(krnl->mm->pgd[pgn], PAGING_PTE_RDONLY_MASK);
+
+  return 0;
+}
+
 
 /* Get PTE page table entry
  * @caller : caller
  * @pgn    : page number
  * @ret    : page table entry
  **/
-uint32_t pte_get_entry(struct pcb_t *caller, addr_t pgn)
+addr_t pte_get_entry(struct pcb_t *caller, addr_t pgn)
 {
   printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
@@ -145,7 +171,7 @@ uint32_t pte_get_entry(struct pcb_t *caller, addr_t pgn)
  * @pgn    : page number
  * @ret    : page table entry
  **/
-int pte_set_entry(struct pcb_t *caller, addr_t pgn, uint32_t pte_val)
+int pte_set_entry(struct pcb_t *caller, addr_t pgn, addr_t pte_val)
 {
 	struct krnl_t *krnl = caller->krnl;
 	krnl->mm->pgd[pgn]=pte_val;
@@ -218,6 +244,13 @@ int __swap_cp_page(struct memphy_struct *mpsrc, addr_t srcfpn,
   return 0;
 }
 
+int __swap_mv_page(struct memphy_struct *mpsrc, addr_t srcfpn,
+                   struct memphy_struct *mpdst, addr_t dstfpn)
+{
+  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  return 0;
+}
+
 /*
  *Initialize a empty Memory Management instance
  * @mm:     self mm
@@ -229,6 +262,22 @@ int init_mm(struct mm_struct *mm, struct pcb_t *caller)
   return 0;
 }
 
+struct mm_struct *mmlist_next(struct mm_struct *mm)
+{
+  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  return 0;
+}
+
+void mm_unlink(struct mm_struct *mm)
+{
+  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+}
+
+void free_mm(struct mm_struct *mm)
+{
+  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+}
+
 struct vm_rg_struct *init_vm_rg(addr_t rg_start, addr_t rg_end)
 {
   printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
@@ -241,7 +290,25 @@ int enlist_vm_rg_node(struct vm_rg_struct **rglist, struct vm_rg_struct *rgnode)
   return 0;
 }
 
-int enlist_pgn_node(struct pgn_t **plist, addr_t pgn)
+int enlist_pgn_node(struct pcb_t *caller, addr_t pgn, addr_t fpn)
+{
+  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  return 0;
+}
+
+int enlist_pgn_range(struct pcb_t *caller, addr_t pgn, int pgnum, struct framephy_struct *frames)
+{
+  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  return 0;
+}
+
+int delist_pgn_node(struct pcb_t *caller, addr_t fpn)
+{
+  printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
+  return 0;
+}
+
+int vmap_zero_range(struct pcb_t *caller, addr_t pgn, int pgnum, addr_t fpn)
 {
   printf("[ERROR] %s: This feature 32 bit mode is deprecated\n", __func__);
   return 0;
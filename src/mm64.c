@@ -17,6 +17,7 @@
 #include "mm64.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <stdlib.h>
 
@@ -110,6 +111,126 @@ int get_pd_from_pagenum(addr_t pgn,
 }
 
 
+/*
+ * pd_walk - walk the radix page table down to an entry of a page
+ * @mm    : page table owner
+ * @pgn   : page number
+ * @alloc : allocate the missing lower-level tables on the way
+ * @stop  : level of the returned entry, PAGING64_LV_PMD or PAGING64_LV_PT
+ *
+ * Each directory entry holds the address of its lower-level table or 0,
+ * tables are only allocated for the parts of the address space in use.
+ * The walk starts at the lowest table found in the page-walk cache.
+ * A huge PMD entry ends the walk early, the PMD slot is returned and
+ * @huge (optional) is set, PTE and huge PDE layouts overlap so the
+ * entry value alone does not tell them apart.
+ * Return the slot, NULL when a table is missing and @alloc is off.
+ */
+static addr_t *pd_walk(struct mm_struct *mm, addr_t pgn, int alloc, int stop, int *huge)
+{
+  addr_t idx[PAGING64_PT_LEVELS];
+  addr_t *tbl = mm->pgd;
+  addr_t *ent;
+  int lv = 0, c;
+
+  if (huge != NULL)
+    *huge = 0;
+
+  if (tbl == NULL)
+    return NULL;
+
+  get_pd_from_pagenum(pgn, &idx[0], &idx[1], &idx[2], &idx[3], &idx[4]);
+
+  /* pwc[c] caches the table at level PT - c */
+  for (c = 0; c < PAGING_PWC_LEVELS; c++)
+  {
+    if (PAGING64_LV_PT - c <= stop && mm->pwc[c].tbl != NULL &&
+        mm->pwc[c].tag == pgn >> (PAGING64_PT_IDX_BITS * (c + 1)))
+    {
+      tbl = mm->pwc[c].tbl;
+      lv = PAGING64_LV_PT - c;
+      break;
+    }
+  }
+
+  if (lv > 0)
+    mm->pwc_hits++;
+  else
+    mm->pwc_misses++;
+
+  for (; lv < stop; lv++)
+  {
+    ent = &tbl[idx[lv]];
+    if (PAGING64_PDE_HUGE(*ent))
+    {
+      if (huge != NULL)
+        *huge = 1;
+      return ent;
+    }
+
+    if (*ent == 0)
+    {
+      if (!alloc)
+        return NULL;
+
+      *ent = (addr_t)calloc(PAGING64_PTRS_PER_TBL, sizeof(addr_t));
+      if (*ent == 0)
+        return NULL;  // malloc error
+    }
+    tbl = (addr_t *)*ent;
+
+    /* Remember the PUD, PMD and PT tables for the neighbouring pages */
+    c = PAGING64_LV_PT - 1 - lv;
+    if (c < PAGING_PWC_LEVELS)
+    {
+      mm->pwc[c].tag = pgn >> (PAGING64_PT_IDX_BITS * (c + 1));
+      mm->pwc[c].tbl = tbl;
+    }
+  }
+
+  return &tbl[idx[stop]];
+}
+
+/*
+ * pte_walk - walk the radix page table down to the PTE of a page
+ * @mm    : page table owner
+ * @pgn   : page number
+ * @alloc : allocate the missing lower-level tables on the way
+ *
+ * Return the PTE slot, NULL when a table is missing and @alloc is off
+ * or when the page belongs to a huge mapping.
+ */
+static addr_t *pte_walk(struct mm_struct *mm, addr_t pgn, int alloc)
+{
+  int huge;
+  addr_t *pte = pd_walk(mm, pgn, alloc, PAGING64_LV_PT, &huge);
+
+  if (huge)
+    return NULL;
+
+  return pte;
+}
+
+/*
+ * pte_walk_leaf - walk to the PTE of a page for a range operation
+ * @mm    : page table owner
+ * @pgn   : first page of the run
+ * @nr    : in: pages left in the range, out: pages of the run that sit
+ *          in the same leaf table
+ *
+ * The run continues in consecutive slots, so one walk serves up to a
+ * whole leaf table. Lower-level tables are allocated on the way.
+ */
+static addr_t *pte_walk_leaf(struct mm_struct *mm, addr_t pgn, int *nr)
+{
+  addr_t left = PAGING64_PTRS_PER_TBL - (pgn & (PAGING64_PTRS_PER_TBL - 1));
+
+  if ((addr_t)*nr > left)
+    *nr = left;
+
+  return pte_walk(mm, pgn, 1);
+}
+
 /*
  * pte_set_swap - Set PTE entry for swapped page
  * @pte    : target page table entry (PTE)
@@ -119,23 +240,12 @@ int get_pd_from_pagenum(addr_t pgn,
 int pte_set_swap(struct pcb_t *caller, addr_t pgn, int swptyp, addr_t swpoff)
 {
   struct krnl_t *krnl = caller->krnl;
-  struct mm_struct *mm = krnl->mm;
-  addr_t pgd = 0;
-  addr_t p4d = 0;
-  addr_t pud = 0;
-  addr_t pmd = 0;
-  addr_t pt  = 0;
   addr_t *pte;
 
 #ifdef MM64
-  get_pd_from_pagenum(pgn, &pgd, &p4d, &pud, &pmd, &pt);
-
-  if (mm->pgd[pgd] == 0) mm->pgd[pgd] = 1;
-  if (mm->p4d[p4d] == 0) mm->p4d[p4d] = 1;
-  if (mm->pud[pud] == 0) mm->pud[pud] = 1;
-  if (mm->pmd[pmd] == 0) mm->pmd[pmd] = 1;
-
-  pte = &mm->pt[pt];
+  pte = pte_walk(krnl->mm, pgn, 1);
+  if (pte == NULL)
+    return -1;
 #else
   pte = &krnl->mm->pgd[pgn];
 #endif
@@ -146,6 +256,9 @@ int pte_set_swap(struct pcb_t *caller, addr_t pgn, int swptyp, addr_t swpoff)
   SETVAL(*pte, swptyp, PAGING_PTE_SWPTYP_MASK, PAGING_PTE_SWPTYP_LOBIT);
   SETVAL(*pte, swpoff, PAGING_PTE_SWPOFF_MASK, PAGING_PTE_SWPOFF_LOBIT);
 
+  /* The page left RAM, drop stale translations */
+  tlb_invalidate(krnl->mm, pgn);
+
   return 0;
 }
 
@@ -158,33 +271,87 @@ int pte_set_swap(struct pcb_t *caller, addr_t pgn, int swptyp, addr_t swpoff)
 int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
 {
   struct krnl_t *krnl = caller->krnl;
-  struct mm_struct *mm = krnl->mm;
-
-  addr_t pgd = 0;
-  addr_t p4d = 0;
-  addr_t pud = 0;
-  addr_t pmd = 0;
-  addr_t pt  = 0;
   addr_t *pte;
 
 #ifdef MM64
-  get_pd_from_pagenum(pgn, &pgd, &p4d, &pud, &pmd, &pt);
-
-  if (mm->pgd[pgd] == 0) mm->pgd[pgd] = 1;
-  if (mm->p4d[p4d] == 0) mm->p4d[p4d] = 1;
-  if (mm->pud[pud] == 0) mm->pud[pud] = 1;
-  if (mm->pmd[pmd] == 0) mm->pmd[pmd] = 1;
-
-  pte = &mm->pt[pt];
+  pte = pte_walk(krnl->mm, pgn, 1);
+  if (pte == NULL)
+    return -1;
 #else
   pte = &krnl->mm->pgd[pgn];
 #endif
 
   SETBIT(*pte, PAGING_PTE_PRESENT_MASK);
   CLRBIT(*pte, PAGING_PTE_SWAPPED_MASK);
+  CLRBIT(*pte, PAGING_PTE_RDONLY_MASK);
+  CLRBIT(*pte, PAGING_PTE_ACCESSED_MASK);
+  CLRBIT(*pte, PAGING_PTE_DIRTY_MASK);
 
   SETVAL(*pte, fpn, PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
 
+  tlb_invalidate(krnl->mm, pgn);
+
+  return 0;
+}
+
+/*
+ * pte_set_bits - Set status bits of a PTE
+ * @pgn   : page number
+ * @mask  : bits to set, e.g. PAGING_PTE_ACCESSED_MASK
+ *
+ * Setting a status bit does not shoot down the TLB, the caller refreshes
+ * its own entry.
+ */
+int pte_set_bits(struct pcb_t *caller, addr_t pgn, addr_t mask)
+{
+  addr_t *pte = pte_walk(caller->krnl->mm, pgn, 0);
+
+  if (pte == NULL)
+    return -1;
+
+  SETBIT(*pte, mask);
+
+  return 0;
+}
+
+/*
+ * pte_clr_bits - Clear status bits of a PTE
+ * @pgn   : page number
+ * @mask  : bits to clear
+ *
+ * Cached translations are dropped so the next access walks the table and
+ * sets the bits again.
+ */
+int pte_clr_bits(struct pcb_t *caller, addr_t pgn, addr_t mask)
+{
+  addr_t *pte = pte_walk(caller->krnl->mm, pgn, 0);
+
+  if (pte == NULL)
+    return -1;
+
+  CLRBIT(*pte, mask);
+
+  tlb_invalidate(caller->krnl->mm, pgn);
+
+  return 0;
+}
+
+/*
+ * pte_set_rdonly - Write-protect an on-line page
+ * @pgn   : page number
+ */
+int pte_set_rdonly(struct pcb_t *caller, addr_t pgn)
+{
+  struct krnl_t *krnl = caller->krnl;
+  addr_t *pte = pte_walk(krnl->mm, pgn, 0);
+
+  if (pte == NULL)
+    return -1;
+
+  SETBIT(*pte, PAGING_PTE_RDONLY_MASK);
+
+  tlb_invalidate(krnl->mm, pgn);
+
   return 0;
 }
 
@@ -195,37 +362,80 @@ int pte_set_fpn(struct pcb_t *caller, addr_t pgn, addr_t fpn)
  * @pgn    : page number
  * @ret    : page table entry
  **/
-uint32_t pte_get_entry(struct pcb_t *caller, addr_t pgn)
+addr_t pte_get_entry(struct pcb_t *caller, addr_t pgn)
 {
+    addr_t pte = 0;
+
     if (caller == NULL || caller->krnl == NULL || caller->krnl->mm == NULL)
         return 0;
 
-    struct krnl_t *krnl = caller->krnl;
-    struct mm_struct *mm = krnl->mm;
+    pte_lookup(caller, pgn, &pte);
 
-    if (mm->pgd == NULL || mm->p4d == NULL || mm->pud == NULL ||
-        mm->pmd == NULL || mm->pt == NULL)
-        return 0;
+    return pte;
+}
+
+/* Look up the PTE of a page, huge mappings included
+ * @caller : caller
+ * @pgn    : page number
+ * @pte    : returned entry, for a huge mapping a PTE of the page is
+ *           built from the run base frame
+ * @ret    : 1 for a huge mapping, 0 for a regular PTE, -1 if unmapped
+ **/
+int pte_lookup(struct pcb_t *caller, addr_t pgn, addr_t *pte)
+{
+    int huge;
+    addr_t *slot = pd_walk(caller->krnl->mm, pgn, 0, PAGING64_LV_PT, &huge);
 
-    uint32_t pte = 0;
-    addr_t pgd = 0;
-    addr_t p4d = 0;
-    addr_t pud = 0;
-    addr_t pmd = 0;
-    addr_t pt  = 0;
+    *pte = 0;
 
-    get_pd_from_pagenum(pgn, &pgd, &p4d, &pud, &pmd, &pt);
+    /* No table on the way, the page was never mapped */
+    if (slot == NULL)
+        return -1;
 
-    if (pgd >= 512 || p4d >= 512 || pud >= 512 || pmd >= 512 || pt >= 512)
-        return 0;
+    if (huge)
+    {
+        addr_t fpn = PAGING64_PDE_FPN(*slot) + (pgn & (PAGING64_HUGE_PGNUM - 1));
+
+        /* Pinned, never aged nor written back */
+        SETBIT(*pte, PAGING_PTE_PRESENT_MASK);
+        SETBIT(*pte, PAGING_PTE_ACCESSED_MASK);
+        SETBIT(*pte, PAGING_PTE_DIRTY_MASK);
+        SETVAL(*pte, fpn, PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
+        return 1;
+    }
 
-    if (mm->pgd[pgd] == 0) return 0;
-    if (mm->p4d[p4d] == 0) return 0;
-    if (mm->pud[pud] == 0) return 0;
-    if (mm->pmd[pmd] == 0) return 0;
+    *pte = *slot;
+    return 0;
+}
 
-    pte = mm->pt[pt];
-    return pte;
+/*
+ * vmap_huge_page - map a PMD entry to a contiguous run of frames
+ * @caller : caller
+ * @pgn    : first page, aligned to PAGING64_HUGE_PGNUM
+ *
+ * The run is pinned in RAM, it is not tracked for page replacement.
+ */
+int vmap_huge_page(struct pcb_t *caller, addr_t pgn)
+{
+  struct mm_struct *mm = caller->krnl->mm;
+  addr_t *pde;
+  addr_t fpn;
+
+  if (pgn & (PAGING64_HUGE_PGNUM - 1))
+    return -1;
+
+  pde = pd_walk(mm, pgn, 1, PAGING64_LV_PMD, NULL);
+
+  /* Only an unused PMD entry can be turned into a huge one */
+  if (pde == NULL || *pde != 0)
+    return -1;
+
+  if (MEMPHY_alloc_contig(caller->krnl->mram, PAGING64_HUGE_ORDER, &fpn) < 0)
+    return -1;
+
+  *pde = PAGING64_PDE_HUGE_MASK | fpn;
+
+  return 0;
 }
 
 
@@ -234,25 +444,16 @@ uint32_t pte_get_entry(struct pcb_t *caller, addr_t pgn)
  * @pgn    : page number
  * @ret    : page table entry
  **/
-int pte_set_entry(struct pcb_t *caller, addr_t pgn, uint32_t pte_val)
+int pte_set_entry(struct pcb_t *caller, addr_t pgn, addr_t pte_val)
 {
-  struct krnl_t *krnl = caller->krnl;
-  struct mm_struct *mm = krnl->mm;
-
-  addr_t pgd = 0;
-  addr_t p4d = 0;
-  addr_t pud = 0;
-  addr_t pmd = 0;
-  addr_t pt  = 0;
+  addr_t *pte = pte_walk(caller->krnl->mm, pgn, 1);
 
-  get_pd_from_pagenum(pgn, &pgd, &p4d, &pud, &pmd, &pt);
+  if (pte == NULL)
+    return -1;
 
-  if (mm->pgd[pgd] == 0) mm->pgd[pgd] = 1;
-  if (mm->p4d[p4d] == 0) mm->p4d[p4d] = 1;
-  if (mm->pud[pud] == 0) mm->pud[pud] = 1;
-  if (mm->pmd[pmd] == 0) mm->pmd[pmd] = 1;
+  *pte = pte_val;
 
-  mm->pt[pt] = pte_val;
+  tlb_invalidate(caller->krnl->mm, pgn);
 
   return 0;
 }
@@ -267,7 +468,9 @@ int vmap_pgd_memset(struct pcb_t *caller,           // process call
                     int pgnum)                      // num of mapping page
 {
   int pgit = 0;
-  uint64_t pattern = 0xdeadbeef;
+  /* Poison the user field only, the entry stays a valid non-present PTE
+   * with no frame and no swap slot, a later touch faults it in */
+  addr_t pattern = ((addr_t)0xdeadbeef << PAGING_PTE_USRNUM_LOBIT) & PAGING_PTE_USRNUM_MASK;
   addr_t pgn;
 
 
@@ -285,36 +488,61 @@ int vmap_pgd_memset(struct pcb_t *caller,           // process call
 
     struct krnl_t *krnl = caller->krnl;
     struct mm_struct *mm = krnl->mm;
+    addr_t *pte;
+    int nr, i;
 
-    for (pgit = 0; pgit < pgnum; pgit++)
+    for (pgit = 0; pgit < pgnum; pgit += nr)
     {
         /*  Compute virtual page number */
         pgn = (addr / PAGING_PAGESZ) + pgit;
 
-        /*  Extract multi-level indices */
-        addr_t pgd, p4d, pud, pmd, pt;
-        get_pd_from_pagenum(pgn, &pgd, &p4d, &pud, &pmd, &pt);
+        /*  Ensure multi-level directories exist, once per leaf table */
+        nr = pgnum - pgit;
+        pte = pte_walk_leaf(mm, pgn, &nr);
+        if (pte == NULL)
+            return -1;
+
+        /*  Write the pattern into the consecutive PT entries */
+        for (i = 0; i < nr; i++)
+            pte[i] = pattern;
+    }
 
-        /*  Ensure multi-level directories exist */
-        if (mm->pgd[pgd] == 0)
-            mm->pgd[pgd] = 1;
+    tlb_invalidate_range(mm, addr / PAGING_PAGESZ, pgnum);
 
-        if (mm->p4d[p4d] == 0)
-            mm->p4d[p4d] = 1;
+  return 0;
+}
 
-        if (mm->pud[pud] == 0)
-            mm->pud[pud] = 1;
+/*
+ * vmap_zero_range - map the untouched pages of a range read-only to a frame
+ * @caller : caller
+ * @pgn    : first page
+ * @pgnum  : number of pages, the range must not cross a leaf table
+ * @fpn    : shared frame, e.g. the zero frame
+ *
+ * Return the number of pages mapped.
+ */
+int vmap_zero_range(struct pcb_t *caller, addr_t pgn, int pgnum, addr_t fpn)
+{
+  addr_t *pte;
+  int nr = pgnum, i, cnt = 0;
 
-        if (mm->pmd[pmd] == 0)
-            mm->pmd[pmd] = 1;
+  pte = pte_walk_leaf(caller->krnl->mm, pgn, &nr);
+  if (pte == NULL)
+    return 0;
 
-        /*  Write the pattern into the final PT entry */
-        mm->pt[pt] = (uint32_t)pattern;
-    }
-  
+  for (i = 0; i < nr; i++)
+  {
+    if (pte[i] != 0)
+      continue;
 
+    SETBIT(pte[i], PAGING_PTE_PRESENT_MASK);
+    SETBIT(pte[i], PAGING_PTE_RDONLY_MASK);
+    SETVAL(pte[i], fpn, PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
+    cnt++;
+  }
 
-  return 0;
+  /* Empty slots have no cached translation to shoot down */
+  return cnt;
 }
 
 /*
@@ -347,32 +575,40 @@ addr_t vmap_page_range(struct pcb_t *caller,           // process call
   /* Tracking for later page replacement activities (if needed)
    * Enqueue new usage page */
   //enlist_pgn_node(&caller->krnl->mm->fifo_pgn, pgn64 + pgit);
+    struct mm_struct *mm = caller->krnl->mm;
     struct framephy_struct *fpit = frames;
-    int pgit;
-    addr_t pgn;
+    int pgit, nr, i;
+    addr_t pgn, *pte;
 
     /* ===  Update returned region === */
     ret_rg->rg_start = addr;
     ret_rg->rg_end   = addr + pgnum * PAGING_PAGESZ; 
     /* ===  Map every virtual page to each physical frames === */
-    for (pgit = 0; pgit < pgnum; pgit++)
+    for (pgit = 0; pgit < pgnum && fpit; pgit += nr)
     {
-        if (!fpit)
-            break;  // no more frames in list 
-
         /* Virtual page number of this mapping */
         pgn = (addr / PAGING_PAGESZ) + pgit;
-      
-        /* Map virtual page -> physical frame */
-        pte_set_fpn(caller, pgn, fpit->fpn);
-        //Enqueue new usage page
-        /* Tracking for page replacement */
-        enlist_pgn_node(&caller->krnl->mm->fifo_pgn, pgn);
 
-        /* Advance to next frame */
-        fpit = fpit->fp_next;
+        /* One walk covers the pages sharing this leaf table */
+        nr = pgnum - pgit;
+        pte = pte_walk_leaf(mm, pgn, &nr);
+        if (pte == NULL)
+            return -1;
+
+        /* Map virtual page -> physical frame */
+        for (i = 0; i < nr && fpit; i++, fpit = fpit->fp_next)
+        {
+            SETBIT(pte[i], PAGING_PTE_PRESENT_MASK);
+            CLRBIT(pte[i], PAGING_PTE_SWAPPED_MASK);
+            SETVAL(pte[i], fpit->fpn, PAGING_PTE_FPN_MASK, PAGING_PTE_FPN_LOBIT);
+        }
+        nr = i;
     }
 
+    tlb_invalidate_range(mm, addr / PAGING_PAGESZ, pgit);
+
+    /* Tracking for page replacement, the whole range at once */
+    enlist_pgn_range(caller, addr / PAGING_PAGESZ, pgit, frames);
 
   return 0;
 }
@@ -409,43 +645,97 @@ addr_t alloc_pages_range(struct pcb_t *caller, int req_pgnum, struct framephy_st
     }
   }
 */
-    addr_t fpn;
+    addr_t *fpns;
     int pgit;
+    struct framephy_struct *tail = NULL;
 
     /* Result list initially empty */
     *frm_lst = NULL;
 
+    if (req_pgnum <= 0)
+        return 0;
+
+    fpns = malloc(req_pgnum * sizeof(addr_t));
+    if (!fpns)
+        return -1;  // malloc error
+
+    /* Take all frames in one go, one lock round-trip instead of one per page */
+    if (MEMPHY_get_freefp_n(caller->krnl->mram, req_pgnum, fpns) < 0)
+    {
+        free(fpns);
+        /* Not enough free frames in RAM return -3000 when RAM exhausted*/
+        return -3000;
+    }
+
     for (pgit = 0; pgit < req_pgnum; pgit++)
     {
-        /* Try obtaining one free physical frame from RAM , if still free, write free frame number to fpn*/
-        //When success MEMPHY_get_freefp, it write frame page number to pointer fpn
-        if (MEMPHY_get_freefp(caller->krnl->mram, &fpn) == 0)
-        {
-            /* Allocate a new framephy_struct node */
-            struct framephy_struct *newfp = (struct framephy_struct *)malloc(sizeof(struct framephy_struct));
+        /* Allocate a new framephy_struct node */
+        struct framephy_struct *newfp = (struct framephy_struct *)malloc(sizeof(struct framephy_struct));
 
-            if (!newfp)
-                return -1;  // malloc error
+        if (!newfp)
+        {
+            free(fpns);
+            return -1;  // malloc error
+        }
 
-            newfp->fpn   = fpn; //Get fpn by MEMPHY_get_freefp
-            newfp->owner = caller->krnl->mm;
+        newfp->fpn     = fpns[pgit];
+        newfp->owner   = caller->krnl->mm;
+        newfp->fp_next = NULL;
 
-            /* Push to list */
-            newfp->fp_next = *frm_lst;
+        /* Append to keep the list in allocation order */
+        if (tail == NULL)
             *frm_lst = newfp;
-        }
         else
-        {
-            /* Not enough free frames in RAM return -3000 when RAM exhausted*/
-            return -3000;
-        }
+            tail->fp_next = newfp;
+        tail = newfp;
     }
 
+    free(fpns);
+
   /* End TODO */
 
   return 0;
 }
 
+/*
+ * vunmap_page_range - undo the mappings vm_map_ram made so far
+ * @caller : caller
+ * @pgn    : first page
+ * @endpgn : end of the range
+ *
+ * The pages are fresh, resident and private, their frames go straight
+ * back to RAM.
+ */
+static void vunmap_page_range(struct pcb_t *caller, addr_t pgn, addr_t endpgn)
+{
+  struct mm_struct *mm = caller->krnl->mm;
+  struct memphy_struct *mram = caller->krnl->mram;
+  addr_t start = pgn, *slot;
+  int huge;
+
+  for (; pgn < endpgn; pgn++)
+  {
+    slot = pd_walk(mm, pgn, 0, PAGING64_LV_PT, &huge);
+    if (slot == NULL)
+      continue;
+
+    if (huge)
+    {
+      /* A huge run goes back whole, then skip the rest of it */
+      MEMPHY_free_contig(mram, PAGING64_PDE_FPN(*slot), PAGING64_HUGE_ORDER);
+      pgn |= PAGING64_HUGE_PGNUM - 1;
+    }
+    else if (PAGING_PAGE_PRESENT(*slot))
+    {
+      delist_pgn_node(caller, PAGING_FPN(*slot));
+      MEMPHY_put_freefp(mram, PAGING_FPN(*slot));
+    }
+    *slot = 0;
+  }
+
+  tlb_invalidate_range(mm, start, endpgn - start);
+}
+
 /*
  * vm_map_ram - do the mapping all vm are to ram storage device
  * @caller    : caller
@@ -458,8 +748,8 @@ addr_t alloc_pages_range(struct pcb_t *caller, int req_pgnum, struct framephy_st
 //This does allocate + mapping workflow
 addr_t vm_map_ram(struct pcb_t *caller, addr_t astart, addr_t aend, addr_t mapstart, int incpgnum, struct vm_rg_struct *ret_rg)
 {
-  struct framephy_struct *frm_lst = NULL;
-  addr_t ret_alloc = 0;
+  struct framephy_struct *frm_lst = NULL, *fp;
+  int ret_alloc = 0;
 //  int pgnum = incpgnum;
 
   /*@bksysnet: author provides a feasible solution of getting frames
@@ -469,20 +759,67 @@ addr_t vm_map_ram(struct pcb_t *caller, addr_t astart, addr_t aend, addr_t mapst
    *in endless procedure of swap-off to get frame and we have not provide
    *duplicate control mechanism, keep it simple
    */
-   ret_alloc = alloc_pages_range(caller, incpgnum, &frm_lst);
+  struct vm_rg_struct chunk_rg;
+  addr_t pgn = mapstart / PAGING_PAGESZ;
+  addr_t endpgn = pgn + incpgnum;
+  addr_t nxtpgn;
 
-  if (ret_alloc < 0 && ret_alloc != -3000)
-    return -1;
+  ret_rg->rg_start = mapstart;
+  ret_rg->rg_end   = mapstart + incpgnum * PAGING_PAGESZ;
 
-  /* Out of memory */
-  if (ret_alloc == -3000)
+  while (pgn < endpgn)
   {
-    return -1;
-  }
+#ifdef MM_HUGEPAGE
+    /* Aligned PMD-sized chunks take one huge entry instead of 512 PTEs */
+    if (!(pgn & (PAGING64_HUGE_PGNUM - 1)) && endpgn - pgn >= PAGING64_HUGE_PGNUM &&
+        vmap_huge_page(caller, pgn) == 0)
+    {
+      pgn += PAGING64_HUGE_PGNUM;
+      continue;
+    }
+#endif
+
+    /* Regular pages up to the next PMD boundary */
+    nxtpgn = (pgn | (PAGING64_HUGE_PGNUM - 1)) + 1;
+    if (nxtpgn > endpgn)
+      nxtpgn = endpgn;
+
+    ret_alloc = alloc_pages_range(caller, nxtpgn - pgn, &frm_lst);
+
+    /* Out of memory (-3000) or malloc error, drop the earlier chunks */
+    if (ret_alloc < 0)
+    {
+      vunmap_page_range(caller, mapstart / PAGING_PAGESZ, pgn);
+      return -1;
+    }
 
-  /* it leaves the case of memory is enough but half in ram, half in swap
-   * do the swaping all to swapper to get the all in ram */
-   vmap_page_range(caller, mapstart, incpgnum, frm_lst, ret_rg);
+    /* it leaves the case of memory is enough but half in ram, half in swap
+     * do the swaping all to swapper to get the all in ram */
+    if (vmap_page_range(caller, pgn * PAGING_PAGESZ, nxtpgn - pgn, frm_lst, &chunk_rg) != 0)
+    {
+      /* The chunk may be partly mapped, its frames are freed below */
+      vunmap_page_range(caller, mapstart / PAGING_PAGESZ, pgn);
+      for (fp = frm_lst; fp != NULL; fp = fp->fp_next)
+      {
+        pte_set_entry(caller, pgn++, 0);
+        MEMPHY_put_freefp(caller->krnl->mram, fp->fpn);
+      }
+      ret_alloc = -1;
+    }
+
+    /* The frames now live in the page table, drop the carrier list */
+    while (frm_lst != NULL)
+    {
+      fp = frm_lst;
+      frm_lst = frm_lst->fp_next;
+      free(fp);
+    }
+
+    if (ret_alloc < 0)
+      return -1;
+
+    pgn = nxtpgn;
+  }
 
   return 0;
 }
@@ -498,21 +835,39 @@ addr_t vm_map_ram(struct pcb_t *caller, addr_t astart, addr_t aend, addr_t mapst
 int __swap_cp_page(struct memphy_struct *mpsrc, addr_t srcfpn,
                    struct memphy_struct *mpdst, addr_t dstfpn)
 {
-  int cellidx;
-  addr_t addrsrc, addrdst;
-  for (cellidx = 0; cellidx < PAGING_PAGESZ; cellidx++)
-  {
-    addrsrc = srcfpn * PAGING_PAGESZ + cellidx;
-    addrdst = dstfpn * PAGING_PAGESZ + cellidx;
+  BYTE data[PAGING_PAGESZ];
 
-    BYTE data;
-    MEMPHY_read(mpsrc, addrsrc, &data);
-    MEMPHY_write(mpdst, addrdst, data);
-  }
+  /* Bounce through a page buffer so that only one device lock
+   * is held at a time */
+  if (MEMPHY_read_block(mpsrc, srcfpn * PAGING_PAGESZ, data, PAGING_PAGESZ) < 0)
+    return -1;
 
-  return 0;
+  return MEMPHY_write_block(mpdst, dstfpn * PAGING_PAGESZ, data, PAGING_PAGESZ);
+}
+
+/* Swap move content page from source frame to destination frame, the
+ * source frame is left with stale content
+ * @mpsrc  : source memphy
+ * @srcfpn : source physical page number (FPN)
+ * @mpdst  : destination memphy
+ * @dstfpn : destination physical page number (FPN)
+ *
+ * Frame-indirected devices exchange the frame buffers, returns 1 then,
+ * 0 after a copy and -1 on error.
+ **/
+int __swap_mv_page(struct memphy_struct *mpsrc, addr_t srcfpn,
+                   struct memphy_struct *mpdst, addr_t dstfpn)
+{
+  if (mpsrc->frames != NULL && mpdst->frames != NULL)
+    return (MEMPHY_xchg_frame(mpsrc, srcfpn, mpdst, dstfpn) == 0) ? 1 : -1;
+
+  return __swap_cp_page(mpsrc, srcfpn, mpdst, dstfpn);
 }
 
+/* Every mm, a process without pages to give up takes frames from others */
+static struct mm_struct *mmlist_head;
+static pthread_mutex_t mmlist_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /*
  *Initialize a empty Memory Management instance
  * @mm:     self mm
@@ -524,18 +879,27 @@ int init_mm(struct mm_struct *mm, struct pcb_t *caller)
     if (!vma0)
         return -1; /* malloc error */
 
-    /* Init 5-level page tables */
-    mm->pgd = calloc(512, sizeof(addr_t));
-    mm->p4d = calloc(512, sizeof(addr_t));
-    mm->pud = calloc(512, sizeof(addr_t));
-    mm->pmd = calloc(512, sizeof(addr_t));
-    mm->pt  = calloc(512, sizeof(addr_t));
+    /* Init 5-level page tables, only the top level exists up front and
+     * the lower levels are allocated on demand by pte_walk() */
+    mm->pgd = calloc(PAGING64_PTRS_PER_TBL, sizeof(addr_t));
 
-    if (!mm->pgd || !mm->p4d || !mm->pud || !mm->pmd || !mm->pt)
+    if (!mm->pgd)
         return -1;  // malloc error
 
+    for (int c = 0; c < PAGING_PWC_LEVELS; c++)
+        mm->pwc[c].tbl = NULL;
+    mm->pwc_hits = mm->pwc_misses = 0;
+
     /* Init page replacement list (FIFO) */
     mm->fifo_pgn = NULL;
+    memset(&mm->arc, 0, sizeof(struct pgn_arc));
+
+    /* No region is allocated yet */
+    memset(mm->symrgtbl, 0, sizeof(mm->symrgtbl));
+
+    mm->ra.win = PAGING_RA_INIT;
+    mm->ra.hits = 0;
+    mm->ra.issued = 0;
 
     /* Default VMA0 */
     vma0->vm_id    = 0;
@@ -545,15 +909,105 @@ int init_mm(struct mm_struct *mm, struct pcb_t *caller)
     vma0->vm_freerg_list = NULL;
     vma0->vm_next  = NULL;
     vma0->vm_mm    = mm;
+    vma0->vm_shm   = NULL;
 
     struct vm_rg_struct *first_rg = init_vm_rg(vma0->vm_start, vma0->vm_end);
     enlist_vm_rg_node(&vma0->vm_freerg_list, first_rg);
 
     mm->mmap     = vma0;
+
+    pthread_mutex_lock(&mmlist_lock);
+    mm->mmlist = mmlist_head;
+    mmlist_head = mm;
+    pthread_mutex_unlock(&mmlist_lock);
     
     return 0;
 }
 
+/*
+ * mmlist_next - walk the list of every mm
+ * @mm : current mm, NULL for the first one
+ *
+ * Return the next mm, NULL at the end of the list.
+ */
+struct mm_struct *mmlist_next(struct mm_struct *mm)
+{
+  struct mm_struct *next;
+
+  pthread_mutex_lock(&mmlist_lock);
+  next = (mm == NULL) ? mmlist_head : mm->mmlist;
+  pthread_mutex_unlock(&mmlist_lock);
+
+  return next;
+}
+
+/*
+ * mm_unlink - take an mm off the list of every mm
+ * @mm : mm about to be freed
+ */
+void mm_unlink(struct mm_struct *mm)
+{
+  struct mm_struct **pp;
+
+  pthread_mutex_lock(&mmlist_lock);
+  for (pp = &mmlist_head; *pp != NULL; pp = &(*pp)->mmlist)
+    if (*pp == mm)
+    {
+      *pp = mm->mmlist;
+      break;
+    }
+  pthread_mutex_unlock(&mmlist_lock);
+}
+
+/*
+ * pd_free - free a page table and the lower-level tables below it
+ * @tbl : table
+ * @lv  : level of @tbl
+ */
+static void pd_free(addr_t *tbl, int lv)
+{
+  int i;
+
+  if (lv < PAGING64_LV_PT)
+    for (i = 0; i < PAGING64_PTRS_PER_TBL; i++)
+      if (tbl[i] != 0 && !PAGING64_PDE_HUGE(tbl[i]))
+        pd_free((addr_t *)tbl[i], lv + 1);
+
+  free(tbl);
+}
+
+/*
+ * free_mm - free what init_mm and the vm area code built for an mm
+ * @mm : mm without pages, see free_pcb_memph(), already unlinked
+ *
+ * The vm areas, their free region nodes, the page tables and the ghost
+ * entries go, the mm struct itself belongs to the caller.
+ */
+void free_mm(struct mm_struct *mm)
+{
+  struct vm_area_struct *vma;
+  struct vm_rg_struct *rg;
+
+  while ((vma = mm->mmap) != NULL)
+  {
+    mm->mmap = vma->vm_next;
+    while ((rg = vma->vm_freerg_list) != NULL)
+    {
+      vma->vm_freerg_list = rg->rg_next;
+      free(rg);
+    }
+    free(vma);
+  }
+
+  if (mm->pgd != NULL)
+    pd_free(mm->pgd, 0);
+  mm->pgd = NULL;
+  for (int c = 0; c < PAGING_PWC_LEVELS; c++)
+    mm->pwc[c].tbl = NULL;
+
+  arc_release(&mm->arc);
+}
+
 
 struct vm_rg_struct *init_vm_rg(addr_t rg_start, addr_t rg_end)
 {
@@ -574,13 +1028,189 @@ int enlist_vm_rg_node(struct vm_rg_struct **rglist, struct vm_rg_struct *rgnode)
   return 0;
 }
 
-int enlist_pgn_node(struct pgn_t **plist, addr_t pgn)
+/*
+ * pgn_list_add - insert a descriptor as the newest of a page list
+ * @plist : page list
+ * @pnode : descriptor
+ */
+void pgn_list_add(struct pgn_t **plist, struct pgn_t *pnode)
 {
-  struct pgn_t *pnode = malloc(sizeof(struct pgn_t));
+  struct pgn_t *head = *plist;
+
+  if (head == NULL)
+  {
+    pnode->pg_next = pnode;
+    pnode->pg_prev = pnode;
+  }
+  else
+  {
+    pnode->pg_next = head;
+    pnode->pg_prev = head->pg_prev;
+    head->pg_prev->pg_next = pnode;
+    head->pg_prev = pnode;
+  }
 
-  pnode->pgn = pgn;
-  pnode->pg_next = *plist;
   *plist = pnode;
+}
+
+/*
+ * pgn_list_del - unlink a descriptor from a page list
+ * @plist : page list
+ * @pnode : descriptor
+ */
+void pgn_list_del(struct pgn_t **plist, struct pgn_t *pnode)
+{
+  if (pnode->pg_next == pnode)
+    *plist = NULL;
+  else
+  {
+    pnode->pg_prev->pg_next = pnode->pg_next;
+    pnode->pg_next->pg_prev = pnode->pg_prev;
+    if (*plist == pnode)
+      *plist = pnode->pg_next;
+  }
+
+  pnode->pg_next = NULL;
+  pnode->pg_prev = NULL;
+}
+
+/*
+ * pgn_desc - replacement descriptor of a RAM frame
+ * @mram : RAM device
+ * @fpn  : frame number
+ */
+struct pgn_t *pgn_desc(struct memphy_struct *mram, addr_t fpn)
+{
+  if (mram->pgdesc == NULL)
+  {
+    mram->pgdesc = calloc(mram->maxsz / PAGING_PAGESZ, sizeof(struct pgn_t));
+    if (mram->pgdesc == NULL)
+      return NULL;
+  }
+
+  return &mram->pgdesc[fpn];
+}
+
+/*
+ * enlist_pgn_node - track a resident page for replacement
+ * @caller : caller
+ * @pgn    : page number
+ * @fpn    : frame holding the page
+ */
+int enlist_pgn_node(struct pcb_t *caller, addr_t pgn, addr_t fpn)
+{
+  struct pgn_t *pnode = pgn_desc(caller->krnl->mram, fpn);
+
+  if (pnode == NULL)
+    return -1;
+
+#if MM_REPL_POLICY == PAGING_REPL_ARC
+  if (pnode->pg_next != NULL)
+    arc_delist(pnode->pg_mm, pnode);
+
+  pnode->pgn = pgn;
+  pnode->pg_mm = caller->krnl->mm;
+  return arc_enlist(caller, pnode);
+#else
+  if (pnode->pg_next != NULL)
+    pgn_list_del(&pnode->pg_mm->fifo_pgn, pnode);
+
+  pnode->pgn = pgn;
+  pnode->pg_mm = caller->krnl->mm;
+  pgn_list_add(&caller->krnl->mm->fifo_pgn, pnode);
+
+  return 0;
+#endif
+}
+
+/*
+ * enlist_pgn_range - enlist a run of pages in one step
+ * @caller : caller
+ * @pgn    : first page
+ * @pgnum  : number of pages
+ * @frames : frames of the pages, in page order
+ *
+ * Same order as enlisting the pages one by one. The FIFO list gets the
+ * run chained aside then spliced on its head, ARC still looks each page
+ * up in its ghost lists.
+ */
+int enlist_pgn_range(struct pcb_t *caller, addr_t pgn, int pgnum, struct framephy_struct *frames)
+{
+  struct framephy_struct *fpit = frames;
+  int pgit;
+#if MM_REPL_POLICY == PAGING_REPL_ARC
+  for (pgit = 0; pgit < pgnum && fpit != NULL; pgit++, fpit = fpit->fp_next)
+    if (enlist_pgn_node(caller, pgn + pgit, fpit->fpn) != 0)
+      return -1;
+
+  return 0;
+#else
+  struct mm_struct *mm = caller->krnl->mm;
+  struct pgn_t *first = NULL, *last = NULL, *pnode, *head;
+
+  /* Newest page first, as a chain of head insertions would leave it */
+  for (pgit = 0; pgit < pgnum && fpit != NULL; pgit++, fpit = fpit->fp_next)
+  {
+    pnode = pgn_desc(caller->krnl->mram, fpit->fpn);
+    if (pnode == NULL)
+      break;
+
+    if (pnode->pg_next != NULL)
+      pgn_list_del(&pnode->pg_mm->fifo_pgn, pnode);
+
+    pnode->pgn = pgn + pgit;
+    pnode->pg_mm = mm;
+    pnode->pg_prev = NULL;
+    pnode->pg_next = first;
+    if (first != NULL)
+      first->pg_prev = pnode;
+    else
+      last = pnode;
+    first = pnode;
+  }
+
+  if (first != NULL)
+  {
+    head = mm->fifo_pgn;
+    if (head == NULL)
+    {
+      first->pg_prev = last;
+      last->pg_next = first;
+    }
+    else
+    {
+      first->pg_prev = head->pg_prev;
+      last->pg_next = head;
+      head->pg_prev->pg_next = first;
+      head->pg_prev = last;
+    }
+    mm->fifo_pgn = first;
+  }
+
+  return (pgit < pgnum && fpit != NULL) ? -1 : 0;
+#endif
+}
+
+/*
+ * delist_pgn_node - stop tracking a page whose frame is unmapped
+ * @caller : caller
+ * @fpn    : frame of the page
+ *
+ * The frame leaves the lists of the mm tracking it, which is another
+ * mapper than the caller for a frame shared by fork.
+ */
+int delist_pgn_node(struct pcb_t *caller, addr_t fpn)
+{
+  struct pgn_t *pnode = pgn_desc(caller->krnl->mram, fpn);
+
+  if (pnode == NULL || pnode->pg_next == NULL)
+    return -1;
+
+#if MM_REPL_POLICY == PAGING_REPL_ARC
+  arc_delist(pnode->pg_mm, pnode);
+#else
+  pgn_list_del(&pnode->pg_mm->fifo_pgn, pnode);
+#endif
 
   return 0;
 }
@@ -635,14 +1265,16 @@ int print_list_vma(struct vm_area_struct *ivma)
 
 int print_list_pgn(struct pgn_t *ip)
 {
+  struct pgn_t *pg = ip;
+
   printf("print_list_pgn: ");
   if (ip == NULL) { printf("NULL list\n"); return -1; }
   printf("\n");
-  while (ip != NULL)
+  do
   {
-    printf("va[" FORMAT_ADDR "]-\n", ip->pgn);
-    ip = ip->pg_next;
-  }
+    printf("va[" FORMAT_ADDR "]-\n", pg->pgn);
+    pg = pg->pg_next;
+  } while (pg != ip);
   printf("n");
   return 0;
 }
@@ -650,13 +1282,22 @@ int print_list_pgn(struct pgn_t *ip)
 int print_pgtbl(struct pcb_t *caller, addr_t start, addr_t end)
 {
     struct mm_struct *mm = caller->krnl->mm;
+    addr_t idx[PAGING64_PT_LEVELS];
+    addr_t *tbl[PAGING64_PT_LEVELS - 1];
+    int lv;
+
+    /* Tables on the walk path of the start address, NULL if not allocated */
+    get_pd_from_address(start, &idx[0], &idx[1], &idx[2], &idx[3], &idx[4]);
+    tbl[0] = mm->pgd;
+    for (lv = 1; lv < PAGING64_PT_LEVELS - 1; lv++)
+        tbl[lv] = (tbl[lv - 1] != NULL) ? (addr_t *)tbl[lv - 1][idx[lv - 1]] : NULL;
 
     printf("print_pgtbl:\n");
     printf(" PDG=%p P4g=%p PUD=%p PMD=%p\n",
-           (void *)mm->pgd,
-           (void *)mm->p4d,
-           (void *)mm->pud,
-           (void *)mm->pmd);
+           (void *)tbl[0],
+           (void *)tbl[1],
+           (void *)tbl[2],
+           (void *)tbl[3]);
 
     return 0;
 }
@@ -18,8 +18,8 @@ static struct krnl_t os;
 int runtime_paging = 0;   // 0 = non-paging, 1 = paging
 
 #ifdef MM_PAGING
-static int memramsz;
-static int memswpsz[PAGING_MAX_MMSWP];
+static unsigned long memramsz;
+static unsigned long memswpsz[PAGING_MAX_MMSWP];
 
 struct mmpaging_ld_args {
     /* A dispatched argument struct to compact many-fields passing to loader */
@@ -28,6 +28,7 @@ struct mmpaging_ld_args {
     struct memphy_struct **mswp;
     struct memphy_struct *active_mswp;
     int active_mswp_id;
+    struct swap_struct *swap;
     struct timer_id_t  *timer_id;
 };
 #endif
@@ -62,11 +63,22 @@ static void * cpu_routine(void * args) {
     int time_left = 0;
     struct pcb_t * proc = NULL;
 
+#ifdef MM_PAGING
+    /* Frame allocations of this thread go through the CPU magazine */
+    MEMPHY_bind_cpu(id);
+#endif
+
     while (1) {
         next_slot(timer_id);
 
         if (proc && proc->pc == proc->code->size) {
             printf("\tCPU %d: Processed %2d has finished\n", id, proc->pid);
+#if defined(MM_PAGING) && defined(MM64)
+            if (runtime_paging && proc->krnl->mm != NULL)
+                printf("\tPID %d page-walk cache hits: %lu misses: %lu\n", proc->pid,
+                       (unsigned long)proc->krnl->mm->pwc_hits,
+                       (unsigned long)proc->krnl->mm->pwc_misses);
+#endif
             proc = NULL;
             time_left = 0;
         }
@@ -112,6 +124,7 @@ static void * ld_routine(void * args) {
     struct memphy_struct   *mram         = pargs->mram;
     struct memphy_struct  **mswp         = pargs->mswp;
     struct memphy_struct   *active_mswp  = pargs->active_mswp;
+    struct swap_struct     *swap         = pargs->swap;
 #else
     timer_id = (struct timer_id_t*)args;
 #endif
@@ -142,6 +155,7 @@ static void * ld_routine(void * args) {
             krnl->mswp           = mswp;
             krnl->active_mswp    = active_mswp;
             krnl->active_mswp_id = 0;
+            krnl->swap           = swap;
         }
 #endif
 
@@ -169,6 +183,27 @@ static void * ld_routine(void * args) {
     pthread_exit(NULL);
 }
 
+#if defined(MM_PAGING) && defined(MM_KSWAPD)
+/*----------------------------------------------------------
+ * Reclaim daemon routine
+ *---------------------------------------------------------*/
+static void * kswapd_routine(void * args) {
+    struct timer_id_t * timer_id = (struct timer_id_t*)args;
+
+    while (1) {
+        next_slot(timer_id);
+
+        /* Set by the timer once every other device has finished */
+        if (timer_id->fsh)
+            break;
+
+        pg_reclaim(&os);
+    }
+
+    pthread_exit(NULL);
+}
+#endif
+
 /*----------------------------------------------------------
  * Read configuration
  *---------------------------------------------------------*/
@@ -205,7 +240,7 @@ static void read_config(const char * path) {
         }
     } while (line[0] == '\n' || line[0] == '\r');
 
-    int r = sscanf(line, "%d %d %d %d %d",
+    int r = sscanf(line, "%lu %lu %lu %lu %lu",
                    &memramsz,
                    &memswpsz[0],
                    &memswpsz[1],
@@ -323,14 +358,27 @@ int main(int argc, char * argv[]) {
         args[i].id = i;
     }
     struct timer_id_t * ld_event = attach_event();
+#if defined(MM_PAGING) && defined(MM_KSWAPD)
+    pthread_t kswapd;
+    struct timer_id_t * kswapd_event = NULL;
+    if (runtime_paging)
+        kswapd_event = attach_daemon();
+#endif
     start_timer();
 
 #ifdef MM_PAGING
     /* Init all MEMPHY include 1 MEMRAM and n of MEMSWP */
     int rdmflag = 1; /* By default memphy is RANDOM ACCESS MEMORY */
+#ifdef MMSWP_SEQ
+    int swprdmflag = 0; /* Swap devices are sequential, tape-like */
+#else
+    int swprdmflag = rdmflag;
+#endif
 
     struct memphy_struct mram;
     struct memphy_struct mswp[PAGING_MAX_MMSWP];
+    struct memphy_struct *mswp_dev[PAGING_MAX_MMSWP];
+    struct swap_struct swap;
 
     /* In Paging mode, it needs passing the system mem to each PCB through loader*/
     struct mmpaging_ld_args *mm_ld_args =
@@ -340,21 +388,43 @@ int main(int argc, char * argv[]) {
 
     if (runtime_paging) {
         /* Chỉ init RAM/SWAP khi đang ở paging mode */
+#ifdef MMRAM_BUDDY
+        init_memphy_buddy(&mram, memramsz, rdmflag);
+#else
         init_memphy(&mram, memramsz, rdmflag);
+#endif
 
         int sit;
+        for (sit = 0; sit < PAGING_MAX_MMSWP; sit++) {
+#ifdef MMSWP_FILE
+            char swpfile[100];
+            snprintf(swpfile, sizeof(swpfile), MMSWP_FILE, sit);
+            if (init_memphy_file(&mswp[sit], memswpsz[sit], swprdmflag, swpfile) == 0)
+                continue;
+            fprintf(stderr, "Cannot map swap file %s, fall back to memory\n", swpfile);
+#endif
+            init_memphy(&mswp[sit], memswpsz[sit], swprdmflag);
+        }
+
+        /* Swap slots go to every device, the swap type is the index */
         for (sit = 0; sit < PAGING_MAX_MMSWP; sit++)
-            init_memphy(&mswp[sit], memswpsz[sit], rdmflag);
+            mswp_dev[sit] = &mswp[sit];
+        swap_init(&swap, mswp_dev, PAGING_MAX_MMSWP, MM_SWAP_POLICY);
+#ifdef MM_ZSWAP
+        zswap_init(&swap.zpool, memramsz / PAGING_ZSWAP_POOL_DIV);
+#endif
 
         mm_ld_args->mram           = &mram;
-        mm_ld_args->mswp           = (struct memphy_struct**)&mswp;
+        mm_ld_args->mswp           = mswp_dev;
         mm_ld_args->active_mswp    = &mswp[0];
         mm_ld_args->active_mswp_id = 0;
+        mm_ld_args->swap           = &swap;
     } else {
         mm_ld_args->mram           = NULL;
         mm_ld_args->mswp           = NULL;
         mm_ld_args->active_mswp    = NULL;
         mm_ld_args->active_mswp_id = -1;
+        mm_ld_args->swap           = NULL;
     }
 #endif
 
@@ -372,16 +442,57 @@ int main(int argc, char * argv[]) {
         pthread_create(&cpu[i], NULL,
                        cpu_routine, (void*)&args[i]);
     }
+#if defined(MM_PAGING) && defined(MM_KSWAPD)
+    if (kswapd_event != NULL)
+        pthread_create(&kswapd, NULL, kswapd_routine, (void*)kswapd_event);
+#endif
 
     /* Wait for CPU and loader finishing */
     for (i = 0; i < num_cpus; i++) {
         pthread_join(cpu[i], NULL);
     }
     pthread_join(ld, NULL);
+#if defined(MM_PAGING) && defined(MM_KSWAPD)
+    if (kswapd_event != NULL)
+        pthread_join(kswapd, NULL);
+#endif
 
     /* Stop timer */
     stop_timer();
 
+#ifdef MM_PAGING
+    /* Translations each CPU served from its TLB */
+    if (runtime_paging) {
+        uint64_t tlbhits, tlbmisses;
+
+        for (i = 0; i < num_cpus; i++)
+            if (tlb_get_stats(i, &tlbhits, &tlbmisses) == 0)
+                printf("TLB CPU %d hits: %lu misses: %lu\n", i,
+                       (unsigned long)tlbhits, (unsigned long)tlbmisses);
+    }
+#endif
+
+#if defined(MM_PAGING) && defined(MM_ZSWAP)
+    /* What the compressed pool took in and turned away */
+    if (runtime_paging) {
+        addr_t zsize, zstored, zrejected;
+
+        zswap_get_stats(&swap.zpool, &zsize, &zstored, &zrejected);
+        printf("ZSWAP pool: %lu/%lu bytes, stored: %lu rejected: %lu\n",
+               (unsigned long)zsize, (unsigned long)swap.zpool.maxsz,
+               (unsigned long)zstored, (unsigned long)zrejected);
+    }
+#endif
+
+#if defined(MM_PAGING) && defined(MMSWP_SEQ)
+    /* Distance the cursor of each swap device travelled */
+    if (runtime_paging)
+        for (i = 0; i < PAGING_MAX_MMSWP; i++)
+            if (memswpsz[i] > 0)
+                printf("MEMSWP %d seek cost: %lu\n", i,
+                       (unsigned long)MEMPHY_get_seekcost(&mswp[i]));
+#endif
+
     return 0;
 }
 
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+#include "common.h"
+#include "syscall.h"
+#include "queue.h"
+#include "sched.h"
+#include "loader.h"
+#include "mm.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Syscall handler for process creation
+ *   int __sys_fork(struct krnl_t *krnl, uint32_t pid, struct sc_regs *regs)
+ *
+ * The child is a copy of the caller that resumes after the syscall with
+ * the same registers and code. Its address space is a copy-on-write clone
+ * in a kernel context of its own. Returns the child PID, -1 on failure.
+ */
+int __sys_fork(struct krnl_t *krnl, uint32_t pid, struct sc_regs *regs)
+{
+#ifdef MM_PAGING
+    struct queue_t *running_list = krnl->running_list;
+    struct pcb_t *caller = NULL;
+    struct pcb_t *child;
+
+    if (running_list != NULL) {
+        for (int i = 0; i < running_list->size; i++) {
+            struct pcb_t *proc = running_list->proc[i];
+            if (proc != NULL && proc->pid == pid) {
+                caller = proc;
+                break;
+            }
+        }
+    }
+
+    if (caller == NULL || !runtime_paging) {
+        return -1;
+    }
+
+    child = malloc(sizeof(struct pcb_t));
+    *child = *caller;
+    child->pid = alloc_pid();
+
+    child->page_table = malloc(sizeof(struct page_table_t));
+    memcpy(child->page_table, caller->page_table, sizeof(struct page_table_t));
+
+    /* Same devices and queues, a separate mm */
+    child->krnl = malloc(sizeof(struct krnl_t));
+    *child->krnl = *caller->krnl;
+    child->krnl->mm = malloc(sizeof(struct mm_struct));
+
+    if (copy_mm(caller, child) != 0) {
+        free(child->krnl->mm);
+        free(child->krnl);
+        free(child->page_table);
+        free(child);
+        return -1;
+    }
+
+    printf("\tPID %d forked child PID %d\n", caller->pid, child->pid);
+
+    add_proc(child);
+
+    return child->pid;
+#else
+    (void)krnl;
+    (void)pid;
+    (void)regs;
+    return -1;
+#endif /* MM_PAGING */
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2026 pdnguyen of HCMC University of Technology VNU-HCM
+ */
+
+/* LamiaAtrium release
+ * Source Code License Grant: The authors hereby grant to Licensee
+ * personal permission to use and modify the Licensed Source Code
+ * for the sole purpose of studying while attending the course CO2018.
+ */
+
+#include "common.h"
+#include "syscall.h"
+#include "queue.h"
+#include "mm.h"
+
+#ifdef MM_PAGING
+/* The running process issuing a syscall */
+static struct pcb_t *shm_caller(struct krnl_t *krnl, uint32_t pid)
+{
+    struct queue_t *running_list = krnl->running_list;
+
+    if (running_list == NULL || !runtime_paging) {
+        return NULL;
+    }
+
+    for (int i = 0; i < running_list->size; i++) {
+        struct pcb_t *proc = running_list->proc[i];
+        if (proc != NULL && proc->pid == pid) {
+            return proc;
+        }
+    }
+
+    return NULL;
+}
+#endif
+
+/* Syscall handler for shared memory segment lookup
+ *   int __sys_shmget(struct krnl_t *krnl, uint32_t pid, struct sc_regs *regs)
+ *
+ * a1 is the key and a2 the size in bytes. The segment of the key is
+ * created on first use and removed with its last detach. Returns the
+ * segment id, the key itself, -1 on failure.
+ */
+int __sys_shmget(struct krnl_t *krnl, uint32_t pid, struct sc_regs *regs)
+{
+#ifdef MM_PAGING
+    if (shm_caller(krnl, pid) == NULL) {
+        return -1;
+    }
+
+    return __shmget(regs->a1, regs->a2);
+#else
+    (void)krnl;
+    (void)pid;
+    (void)regs;
+    return -1;
+#endif /* MM_PAGING */
+}
+
+/* Syscall handler for shared memory attach
+ *   int __sys_shmat(struct krnl_t *krnl, uint32_t pid, struct sc_regs *regs)
+ *
+ * a1 is the segment id and a2 the region register the segment is then
+ * read and written through. Every attachment maps the same frames.
+ */
+int __sys_shmat(struct krnl_t *krnl, uint32_t pid, struct sc_regs *regs)
+{
+#ifdef MM_PAGING
+    struct pcb_t *caller = shm_caller(krnl, pid);
+
+    if (caller == NULL || __shmat(caller, regs->a1, regs->a2) != 0) {
+        return -1;
+    }
+
+    printf("\tPID %d attached segment %d to region %d\n",
+           caller->pid, (int)regs->a1, (int)regs->a2);
+
+    return 0;
+#else
+    (void)krnl;
+    (void)pid;
+    (void)regs;
+    return -1;
+#endif /* MM_PAGING */
+}
+
+/* Syscall handler for shared memory detach
+ *   int __sys_shmdt(struct krnl_t *krnl, uint32_t pid, struct sc_regs *regs)
+ *
+ * a1 is the region register the segment was attached to.
+ */
+int __sys_shmdt(struct krnl_t *krnl, uint32_t pid, struct sc_regs *regs)
+{
+#ifdef MM_PAGING
+    struct pcb_t *caller = shm_caller(krnl, pid);
+
+    if (caller == NULL || __shmdt(caller, regs->a1) != 0) {
+        return -1;
+    }
+
+    printf("\tPID %d detached region %d\n", caller->pid, (int)regs->a1);
+
+    return 0;
+#else
+    (void)krnl;
+    (void)pid;
+    (void)regs;
+    return -1;
+#endif /* MM_PAGING */
+}
@@ -35,19 +35,25 @@ static void * timer_routine(void * args) {
 					&temp->id.event_lock
 				);
 			}
-			if (temp->id.fsh) {
-				fsh++;
+			if (!temp->id.daemon) {
+				if (temp->id.fsh) {
+					fsh++;
+				}
+				event++;
 			}
-			event++;
 			pthread_mutex_unlock(&temp->id.event_lock);
 		}
 
 		/* Increase the time slot */
 		_time++;
 		
-		/* Let devices continue their job */
+		/* Let devices continue their job, daemons learn that the
+		 * timer stops with the last device */
 		for (temp = dev_list; temp != NULL; temp = temp->next) {
 			pthread_mutex_lock(&temp->id.timer_lock);
+			if (temp->id.daemon && fsh == event) {
+				temp->id.fsh = 1;
+			}
 			temp->id.done = 0;
 			pthread_cond_signal(&temp->id.timer_cond);
 			pthread_mutex_unlock(&temp->id.timer_lock);
@@ -103,6 +109,7 @@ struct timer_id_t * attach_event() {
 			);
 		container->id.done = 0;
 		container->id.fsh = 0;
+		container->id.daemon = 0;
 		pthread_cond_init(&container->id.event_cond, NULL);
 		pthread_mutex_init(&container->id.event_lock, NULL);
 		pthread_cond_init(&container->id.timer_cond, NULL);
@@ -118,6 +125,16 @@ struct timer_id_t * attach_event() {
 	}
 }
 
+/* Background device, it runs in lockstep with the other devices but
+ * the timer stops without it once they have all finished */
+struct timer_id_t * attach_daemon() {
+	struct timer_id_t * timer_id = attach_event();
+	if (timer_id != NULL) {
+		timer_id->daemon = 1;
+	}
+	return timer_id;
+}
+
 void stop_timer() {
 	timer_stop = 1;
 	pthread_join(_timer, NULL);